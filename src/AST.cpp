@@ -7,11 +7,17 @@
 #include <cstring>
 #include <cstdlib>
 #include <cassert>
+#include <climits>
+#include <algorithm>
 #include "utils.h"
 using namespace std;
 
-KoopaString ks;
+BumpArena ast_arena;
+IdentTable idents;
+IRBuilder irb;
 SymbolTableStack st;
+std::function<void(Value *)> onGlobalVar;
+std::function<void(Function *)> onFunction;
 BlockController bc;
 WhileStack wst;
 
@@ -21,298 +27,391 @@ WhileStack wst;
 
 /**
  * 完成对Local数组初始化的IR生成
- * @param name: 数组在Koopa IR中的名字 
- * @param ptr: 指向数组的内容，例如{"1", "%2"}
- * @param len: 描述数组类型，i.e. 各个维度的长
+ * @param arr: 数组的地址
+ * @param init: 数组的非零初值，k指向下一个要用的
+ * @param base: arr第一个元素在整个数组中展平后的下标
+ * @param len: 描述数组类型，i.e. 各个维度的长，arr从第dim维开始
 */
-void initArray(std::string name, std::string *ptr, const std::vector<int> &len){    
-    int n = len[0];
-    if(len.size() == 1){
+void initArray(Value *arr, const SparseInit<Value *> &init, size_t &k, int base, const std::vector<int> &len, size_t dim){
+    int n = len[dim];
+    if(dim + 1 == len.size()){
         for(int i = 0; i < n; ++i){
-            string tmp = st.getTmpName();
-            ks.getelemptr(tmp, name, i);
-            ks.store(ptr[i], tmp);
+            Value *v = irb.getInt(0);
+            if(k < init.size() && init[k].first == base + i)
+                v = init[k++].second;
+            Value *tmp = irb.createGetElemPtr(arr, irb.getInt(i));
+            irb.createStore(v, tmp);
         }
     } else {
-        vector<int> sublen(len.begin() + 1, len.end());
         int width = 1;
-        for(auto l : sublen)  width *= l;
+        for(size_t j = dim + 1; j < len.size(); ++j)  width *= len[j];
         for(int i = 0; i < n; ++i){
-            string tmp = st.getTmpName();
-            ks.getelemptr(tmp, name, i);
-            initArray(tmp, ptr + i * width, sublen);
+            Value *tmp = irb.createGetElemPtr(arr, irb.getInt(i));
+            initArray(tmp, init, k, base + i * width, len, dim + 1);
         }
     }
 }
 
+// 局部数组中需要补0的元素超过这个数时，用循环清零，而不是逐个store
+static const int ZERO_FILL_MIN = 16;
+// 清零的循环每次迭代清零的元素个数
+static const int ZERO_FILL_UNROLL = 8;
+
+/**
+ * 用循环把连续的n个i32清零，不足一次迭代的尾部逐个store
+ * @param first: 第一个元素的地址
+*/
+static void zeroFill(Value *first, int n){
+    int m = n / ZERO_FILL_UNROLL * ZERO_FILL_UNROLL;
+    Value *i = irb.createAlloc(st.getVarName("ZI"), IRType::getInt32());
+    irb.createStore(irb.getInt(0), i);
+    BasicBlock *loop = irb.createBlock(st.getLabelName("zero_fill"));
+    BasicBlock *end = irb.createBlock(st.getLabelName("zero_fill_end"));
+    irb.createJump(loop);
+
+    bc.set();
+    irb.appendBlock(loop);
+    Value *iv = irb.createLoad(i);
+    Value *p = irb.createGetPtr(first, iv);
+    for(int k = 0; k < ZERO_FILL_UNROLL; ++k)
+        irb.createStore(irb.getInt(0), irb.createGetPtr(p, irb.getInt(k)));
+    Value *next = irb.createBinary(Value::ADD, iv, irb.getInt(ZERO_FILL_UNROLL));
+    irb.createStore(next, i);
+    Value *cond = irb.createBinary(Value::LT, next, irb.getInt(m));
+    irb.createBranch(cond, loop, end);
+
+    bc.set();
+    irb.appendBlock(end);
+    for(int k = m; k < n; ++k)
+        irb.createStore(irb.getInt(0), irb.createGetPtr(first, irb.getInt(k)));
+}
+
+/**
+ * 局部数组的初始化。需要补0的元素不多时逐个store；
+ * 否则先用循环整体清零，再只store非零的元素
+*/
+static void initLocalArray(Value *arr, const SparseInit<Value *> &init, const std::vector<int> &len){
+    int tot_len = 1;
+    for(auto l : len) tot_len *= l;
+    if(tot_len - (int)init.size() <= ZERO_FILL_MIN){
+        size_t k = 0;
+        initArray(arr, init, k, 0, len, 0);
+        return;
+    }
+    // 展平成 *i32，按展平后的下标访问
+    Value *first = arr;
+    for(size_t d = 0; d < len.size(); ++d)
+        first = irb.createGetElemPtr(first, irb.getInt(0));
+    zeroFill(first, tot_len);
+    for(auto &e : init)
+        irb.createStore(e.second, irb.createGetPtr(first, irb.getInt(e.first)));
+}
+
 /**
  * 返回数组中某个元素的指针
- * @param name: 数组在Koopa IR中的名字 
+ * @param arr: 数组的地址
  * @param index: 元素在数组中的下标
 */
-std::string getElemPtr(const std::string &name, const std::vector<std::string>& index){
-    if(index.size() == 1){
-        string tmp = st.getTmpName();
-        ks.getelemptr(tmp, name, index[0]);
-        return tmp;
+Value *getElemPtr(Value *arr, const std::vector<Value *>& index){
+    Value *tmp = arr;
+    for(auto i : index)
+        tmp = irb.createGetElemPtr(tmp, i);
+    return tmp;
+}
+
+/**
+ * 全局数组的初始值，没有非零元素的子数组用zeroinit表示，不逐个列出0
+ * @param init: 数组的非零初值，均为常量，k指向下一个要用的
+ * @param base: 子数组第一个元素展平后的下标
+ * @param tys: tys[d]为从第d维开始的子数组的类型，子数组从第dim维开始
+*/
+static Value *getInitList(const SparseInit<Value *> &init, size_t &k, int base, const std::vector<IRType *> &tys, size_t dim){
+    IRType *ty = tys[dim];
+    int size = ty->getSize() / 4;
+    if(k == init.size() || init[k].first >= base + size)
+        return irb.program->getZeroInit(ty);
+
+    vector<Value *> elems;
+    int n = ty->len;
+    if(dim + 2 == tys.size()){
+        for(int i = 0; i < n; ++i){
+            if(k < init.size() && init[k].first == base + i)
+                elems.push_back(init[k++].second);
+            else
+                elems.push_back(irb.getInt(0));
+        }
     } else {
-        string tmp = st.getTmpName();
-        ks.getelemptr(tmp, name, index[0]);
-        return getElemPtr(
-            tmp,
-            vector<string>(index.begin() + 1, index.end())
-        );
+        int width = size / n;
+        for(int i = 0; i < n; ++i)
+            elems.push_back(getInitList(init, k, base + i * width, tys, dim + 1));
     }
+    return irb.program->getAggregate(ty, elems);
 }
 
-void CompUnitAST::Dump()const {
-    st.alloc(); // 全局作用域
-    this->DumpGlobalVar();
-    // 库函数声明
-    ks.declLibFunc();
-    st.insertFUNC("getint", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("getch", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("getarray", SysYType::SYSY_FUNC_INT);
-    st.insertFUNC("putint", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("putch", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("putarray", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("starttime", SysYType::SYSY_FUNC_VOID);
-    st.insertFUNC("stoptime", SysYType::SYSY_FUNC_VOID);
-
-    int n = func_defs.size();
-    for(int i = 0; i < n; ++i)
-        func_defs[i]->Dump();
-    st.quit();
+static Value *getInitList(const SparseInit<Value *> &init, const std::vector<int> &len){
+    vector<IRType *> tys(len.size() + 1);
+    tys[len.size()] = IRType::getInt32();
+    for(int d = (int)len.size() - 1; d >= 0; --d)
+        tys[d] = IRType::getArray(tys[d + 1], len[d]);
+    size_t k = 0;
+    return getInitList(init, k, 0, tys, 0);
 }
 
-void CompUnitAST::DumpGlobalVar() const{
-     // 全局变量
-    for(auto &d : decls){
-        if(d->tag == DeclAST::CONST_DECL){
-            for(auto &const_def : d->const_decl->const_defs){
-                const_def->Dump(true);
-            }
-        } else {
-           for(auto &var_def: d->var_decl->var_defs){
-                var_def->Dump(true);
-           }
+// 声明库函数，并加入符号表
+void declLibFunc(const std::string &ident, IRType *ret, const std::vector<IRType *> &params){
+    Symbol *sym = st.insertFUNC(idents.intern(ident), ret->tag == IRType::INT32 ? SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
+    sym->func = irb.createFunction(sym->name, ret, params);
+    sym->func->is_lib = true;
+}
+
+void CompUnitAST::Begin() const{
+    st.alloc(); // 全局作用域
+    // 库函数声明
+    IRType *i32 = IRType::getInt32(), *unit = IRType::getUnit(), *ptr = IRType::getPointer(i32);
+    declLibFunc("getint", i32, {});
+    declLibFunc("getch", i32, {});
+    declLibFunc("getarray", i32, {ptr});
+    declLibFunc("putint", unit, {i32});
+    declLibFunc("putch", unit, {i32});
+    declLibFunc("putarray", unit, {i32, ptr});
+    declLibFunc("starttime", unit, {});
+    declLibFunc("stoptime", unit, {});
+    for(auto f : irb.program->funcs)
+        onFunction(f);
+}
+
+void CompUnitAST::DumpDecl(DeclAST *d) const{
+    // 全局变量
+    size_t n = irb.program->globals.size();
+    d->Bind();
+    if(d->tag == DeclAST::CONST_DECL){
+        for(auto &const_def : d->const_decl->const_defs){
+            const_def->Dump(true);
         }
+    } else {
+       for(auto &var_def: d->var_decl->var_defs){
+            var_def->Dump(true);
+       }
     }
-    ks.append("\n");
+    for(size_t i = n; i < irb.program->globals.size(); ++i)
+        onGlobalVar(irb.program->globals[i]);
+    // 顶层之后的token只会是关键字或文件结束，没有存放在内存池中的值，可以整体回收
+    ast_arena.reset();
+}
+
+void CompUnitAST::DumpFuncDef(FuncDefAST *func_def) const{
+    func_def->Bind();
+    func_def->Dump();
+    Function *func = func_def->sym->func;
+    onFunction(func);
+    st.releaseLocals();
+    ast_arena.reset();
+}
 
+void CompUnitAST::End() const{
+    st.quit();
 }
 
 void FuncDefAST::Dump() const {
-    st.resetNameManager();
-    
-    // 函数名加到符号表
-    st.insertFUNC(ident, btype->tag == BTypeAST::INT ? SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
-
-    // fun @main(): i32 {
-    ks.append("fun " + st.getName(ident) + "(");
-
-    // 提前进入到函数内的block，之后把参数load到变量中
-    st.alloc();
-    vector<string> var_names;   //KoopaIR参数列表的名字
-    
-    // 打印函数变量名，并保存到var_names中
-    if(func_params != nullptr){
-        auto &fps = func_params->func_f_params;
-        int n = fps.size();
-        var_names.push_back(st.getVarName(fps[0]->ident));
-        ks.append(var_names.back() + ": ");
-        ks.append(fps[0]->Dump());
-        for(int i = 1; i < n; ++i){
-            ks.append(", ");
-            var_names.push_back(st.getVarName(fps[i]->ident));
-            ks.append(var_names.back() + ": ");
-            ks.append(fps[i]->Dump());
-        }
-    }
-    ks.append(")");
-    if(btype->tag == BTypeAST::INT){
-        ks.append(": i32");
-    }
-    ks.append(" {\n");
+    // fun @main(): i32 {，函数和参数在语义分析时已经创建
+    Function *func = sym->func;
 
     // 进入Block
     bc.set();
-    ks.label("%entry");
+    irb.appendBlock(irb.createBlock("%entry"));
 
     // 提前把虚参加载到变量中
     if(func_params != nullptr){
         int i = 0;
         for(auto &fp : func_params->func_f_params){
-            string var = var_names[i++];
-
-            if(fp->tag == FuncFParamAST::VARIABLE){
-                st.insertINT(fp->ident);
-                string name = st.getName(fp->ident);
-
-                ks.alloc(name);
-                ks.store(var, name);
-            }else{
-                
-                vector<int> len;
-                vector<int> padding_len;
-                padding_len.push_back(-1);
-
-                fp->getIndex(len);
-                for(int l : len) padding_len.push_back(l);
-                
-                st.insertArray(fp->ident, padding_len, SysYType::SYSY_ARRAY);
-                string name = st.getName(fp->ident);
-
-                ks.alloc(name, "*" + ks.getArrayType(len));
-                ks.store(var, name);
-            }
+            Value *var = func->params[i++];
+            Value *addr = irb.createAlloc(fp->sym->name, var->ty);
+            fp->sym->addr = addr;
+            irb.createStore(var, addr);
         }
     }
 
     // 具体内容交给block
-    if(func_params != nullptr){
-        block->Dump(false);
-    }else{
-        block->Dump();
-    }
+    block->Dump();
     // 特判空块
     if(bc.alive()){
         if(btype->tag == BTypeAST::INT)
-            ks.ret("0");
+            irb.createReturn(irb.getInt(0));
         else
-            ks.ret("");
+            irb.createReturn();
     }
-    ks.append("}\n\n");
 }
 
-string FuncFParamAST::Dump() const{
-    if(tag == VARIABLE){
-        return "i32";
-    }
-    string ans = "i32";
-    for(auto &ce: const_exps){
-        ans = "[" + ans + ", " + to_string(ce->getValue()) + "]";
-    }
-    return "*" + ans;
+/**
+ * 语句的IR生成不用递归，而是用显式的栈：每一帧是一个语句块或一条语句，
+ * 记录它进行到了哪一步。语句块、if、while嵌套得再深也不会把调用栈用完。
+*/
+namespace {
+struct StmtFrame{
+    const BlockAST *block;  // 非空表示这一帧是语句块
+    const StmtAST *stmt;
+    size_t phase;           // 语句块: 下一个要处理的BlockItem; 语句: 进行到的阶段
+    BasicBlock *bb[3];      // while: entry, body, end; if: then, else, end
+};
 }
 
-void FuncFParamAST::getIndex(std::vector<int> &len){
-    len.clear();
-    for(auto &ce: const_exps){
-        len.push_back(ce->getValue());
-    }
-    return;
+static StmtFrame blockFrame(const BlockAST *block){
+    return StmtFrame{block, nullptr, 0, {nullptr, nullptr, nullptr}};
 }
 
-void BlockAST::Dump(bool new_symbol_tb) const {
-    // into this Block
-    if(new_symbol_tb)
-        st.alloc();
-   
-    int n = block_items.size();
-
-    for(int i = 0; i < n; ++i){
-        block_items[i]->Dump();
-    }
-    // out of this block
-    st.quit();
+static StmtFrame stmtFrame(const StmtAST *stmt){
+    return StmtFrame{nullptr, stmt, 0, {nullptr, nullptr, nullptr}};
 }
 
-void BlockItemAST::Dump() const{
-    if(!bc.alive()) return;
-    if(tag == DECL){
-        decl->Dump();
-    } else{
-        stmt->Dump();
+// 处理栈顶的语句块，遇到语句就压栈返回，语句处理完后再从下一个BlockItem继续
+static void stepBlock(vector<StmtFrame> &stk){
+    StmtFrame &f = stk.back();
+    const BlockAST *block = f.block;
+    while(f.phase < block->block_items.size()){
+        const BlockItemAST *item = block->block_items[f.phase++];
+        if(!bc.alive()) continue;
+        if(item->tag == BlockItemAST::DECL){
+            item->decl->Dump();
+        } else{
+            stk.push_back(stmtFrame(item->stmt));
+            return;
+        }
     }
+    stk.pop_back();
 }
 
-void DeclAST::Dump() const{
-    if(tag == VAR_DECL)
-        var_decl->Dump();
-    else
-        const_decl->Dump();
-}
-
-
-void StmtAST::Dump() const {
-    if(!bc.alive()) return;
-    if(tag == RETURN){
+// 处理栈顶的语句。需要先生成子语句时，记下阶段，把子语句压栈后返回
+static void stepStmt(vector<StmtFrame> &stk){
+    StmtFrame &f = stk.back();
+    const StmtAST *s = f.stmt;
+    if(f.phase == 0 && !bc.alive()){
+        stk.pop_back();
+        return;
+    }
+    switch(s->tag){
+    case StmtAST::RETURN:
         // bc.finish()写在这里不对！
-        if(exp){
-            string ret_name = exp->Dump();
-            ks.ret(ret_name);
+        if(s->exp){
+            Value *ret_val = s->exp->Dump();
+            irb.createReturn(ret_val);
         } else{
-            ks.ret("");
+            irb.createReturn();
         }
         bc.finish();
-    } else if(tag == ASSIGN){
-        string val = exp->Dump();
-        string to = lval->Dump(true);
-        ks.store(val, to);
-    } else if(tag == BLOCK){
-        block->Dump();
-    } else if(tag == EXP){
-        if(exp){
-            exp->Dump();
+        break;
+    case StmtAST::ASSIGN:{
+        Value *val = s->exp->Dump();
+        Value *to = s->lval->Dump(true);
+        irb.createStore(val, to);
+        break;
+    }
+    case StmtAST::BLOCK:
+        f = blockFrame(s->block);
+        return;
+    case StmtAST::EXP:
+        if(s->exp){
+            s->exp->Dump();
         }
-    } else if(tag == WHILE){
-        string while_entry = st.getLabelName("while_entry");
-        string while_body = st.getLabelName("while_body");
-        string while_end = st.getLabelName("while_end");
-        
-        wst.append(while_entry, while_body, while_end);
+        break;
+    case StmtAST::WHILE:
+        if(f.phase == 0){
+            BasicBlock *while_entry = irb.createBlock(st.getLabelName("while_entry"));
+            BasicBlock *while_body = irb.createBlock(st.getLabelName("while_body"));
+            BasicBlock *while_end = irb.createBlock(st.getLabelName("while_end"));
+            f.bb[0] = while_entry;
+            f.bb[1] = while_body;
+            f.bb[2] = while_end;
+
+            wst.append(while_entry, while_body, while_end);
+
+            // 循环旋转: 进入前先判断一次，之后在循环体末尾的while_entry判断，为真跳回循环体。
+            // 每次迭代只有一次分支。continue跳到while_entry
+            s->exp->DumpCond(while_body, while_end);
 
-        ks.jump(while_entry);
-
-        bc.set();
-        ks.label(while_entry);
-        string cond = exp->Dump();
-        ks.br(cond, while_body, while_end);
+            bc.set();
+            irb.appendBlock(while_body);
+            f.phase = 1;
+            stk.push_back(stmtFrame(s->stmt));
+            return;
+        }
+        if(bc.alive())
+            irb.createJump(f.bb[0]);
 
         bc.set();
-        ks.label(while_body);
-        stmt->Dump();
-        if(bc.alive())
-            ks.jump(while_entry);
+        irb.appendBlock(f.bb[0]);
+        s->exp->DumpCond(f.bb[1], f.bb[2]);
 
         bc.set();
-        ks.label(while_end);
+        irb.appendBlock(f.bb[2]);
         wst.quit(); // 该while处理已结束，退栈
-    } else if(tag == BREAK){
-        ks.jump(wst.getEndName());  // 跳转到while_end
-        bc.finish();                // 当前IR的block设为不活跃
-    } else if(tag == CONTINUE){
-        ks.jump(wst.getEntryName());// 跳转到while_entry
-        bc.finish();                // 当前IR的block设为不活跃
-    } else if(tag == IF){
-        string s = exp->Dump();
-        string t = st.getLabelName("then");
-        string e = st.getLabelName("else");
-        string j = st.getLabelName("end");
-        ks.br(s, t, else_stmt == nullptr ? j : e);
-
-        // IF Stmt
-        bc.set();
-        ks.label(t);
-        if_stmt->Dump();
+        break;
+    case StmtAST::BREAK:
+        irb.createJump(wst.getEnd());   // 跳转到while_end
+        bc.finish();                    // 当前IR的block设为不活跃
+        break;
+    case StmtAST::CONTINUE:
+        irb.createJump(wst.getEntry()); // 跳转到while_entry
+        bc.finish();                    // 当前IR的block设为不活跃
+        break;
+    case StmtAST::IF:
+        if(f.phase == 0){
+            BasicBlock *t = irb.createBlock(st.getLabelName("then"));
+            BasicBlock *e = s->else_stmt == nullptr ? nullptr : irb.createBlock(st.getLabelName("else"));
+            BasicBlock *j = irb.createBlock(st.getLabelName("end"));
+            f.bb[1] = e;
+            f.bb[2] = j;
+            s->exp->DumpCond(t, s->else_stmt == nullptr ? j : e);
+
+            // IF Stmt
+            bc.set();
+            irb.appendBlock(t);
+            f.phase = 1;
+            stk.push_back(stmtFrame(s->if_stmt));
+            return;
+        }
         if(bc.alive())
-            ks.jump(j);
+            irb.createJump(f.bb[2]);
 
         // else stmt
-        if(else_stmt != nullptr){
+        if(f.phase == 1 && s->else_stmt != nullptr){
             bc.set();
-            ks.label(e);
-            else_stmt->Dump();
-            if(bc.alive())
-                ks.jump(j);
-
+            irb.appendBlock(f.bb[1]);
+            f.phase = 2;
+            stk.push_back(stmtFrame(s->else_stmt));
+            return;
         }
         // end
         bc.set();
-        ks.label(j);
+        irb.appendBlock(f.bb[2]);
+        break;
     }
-    return;
+    stk.pop_back();
+}
+
+static void dumpStmtFrames(StmtFrame first){
+    vector<StmtFrame> stk;
+    stk.push_back(first);
+    while(!stk.empty()){
+        if(stk.back().block != nullptr)
+            stepBlock(stk);
+        else
+            stepStmt(stk);
+    }
+}
+
+void BlockAST::Dump() const {
+    dumpStmtFrames(blockFrame(this));
+}
+
+void DeclAST::Dump() const{
+    if(tag == VAR_DECL)
+        var_decl->Dump();
+    else
+        const_decl->Dump();
+}
+
+void StmtAST::Dump() const {
+    dumpStmtFrames(stmtFrame(this));
 }
 
 void ConstDeclAST::Dump() const{
@@ -329,47 +428,31 @@ void VarDeclAST::Dump() const {
     }
 }
 
-void BTypeAST::Dump() const{
-    if(tag == BTypeAST::INT){
-        ks.append("i32");
-    }
-}
-
 void ConstDefAST::Dump(bool is_global) const{
+    // 常量的值在语义分析时已经求出，只有数组需要分配空间
     if(tag == ARRAY){
         DumpArray(is_global);
-        return;
     }
-    int v = const_init_val->getValue();
-    st.insertINTCONST(ident, v);
 }
 
 void ConstDefAST::DumpArray(bool is_global) const{
-    
-
     vector<int> len;
-    for(auto &ce : const_exps){
-        len.push_back(ce->getValue());
-    }
-    st.insertArray(ident, len,SysYType::SYSY_ARRAY_CONST);
-    string name = st.getName(ident);
-    string array_type = ks.getArrayType(len);
+    sym->ty->getArrayType(len);
+    const string &name = sym->name;
+    IRType *array_type = IRType::getArray(len);
 
-    int tot_len = 1;
-    for(auto i : len) tot_len *= i;
-    string *init = new string[tot_len];
-    for(int i = 0; i < tot_len; ++i)
-        init[i] = "0";
-    
-    const_init_val->getInitVal(init, len);
+    SparseInit<Value *> init;
+    for(auto &e : sym->inits)
+        init.emplace_back(e.first, irb.getInt(e.second));
 
     if(is_global){
         // Global Const Array
-        ks.globalAllocArray(name, array_type, ks.getInitList(init, len));
+        sym->addr = irb.createGlobalAlloc(name, array_type, getInitList(init, len), true);
     } else {
         // Local Const Array
-        ks.alloc(name, array_type);
-        initArray(name, init, len);
+        Value *arr = irb.createAlloc(name, array_type);
+        sym->addr = arr;
+        initLocalArray(arr, init, len);
     }
     return;
 }
@@ -379,20 +462,21 @@ void VarDefAST::Dump(bool is_global) const{
         DumpArray(is_global);
         return;
     }
-    st.insertINT(ident);
-    string name = st.getName(ident);
+    const string &name = sym->name;
     if(is_global){
+        Value *init;
         if(init_val == nullptr){
-            ks.globalAllocINT(name);
+            init = irb.program->getZeroInit(IRType::getInt32());
         } else {
-            int v = init_val->exp->getValue();
-            ks.globalAllocINT(name, to_string(v));
+            init = irb.getInt(init_val->exp->getValue());
         }
+        sym->addr = irb.createGlobalAlloc(name, IRType::getInt32(), init);
     } else {
-        ks.alloc(name);
+        Value *addr = irb.createAlloc(name, IRType::getInt32());
+        sym->addr = addr;
         if(init_val != nullptr){
-            string s = init_val->Dump();
-            ks.store(s, name);
+            Value *v = init_val->Dump();
+            irb.createStore(v, addr);
         }
     }
     return;
@@ -400,56 +484,51 @@ void VarDefAST::Dump(bool is_global) const{
 
 void VarDefAST::DumpArray(bool is_global) const {
     vector<int> len;
-    for(auto &ce : const_exps){
-        len.push_back(ce->getValue());
-    }
+    sym->ty->getArrayType(len);
 
-    st.insertArray(ident, len, SysYType::SYSY_ARRAY);
-
-    string name = st.getName(ident);
-    string array_type = ks.getArrayType(len);
-    
-    int tot_len = 1;
-    for(auto i : len) tot_len *= i;
-    string *init = new string[tot_len];
-    for(int i = 0; i < tot_len; ++i)
-        init[i] = "0";
+    const string &name = sym->name;
+    IRType *array_type = IRType::getArray(len);
+    SparseInit<Value *> init;
 
     if(is_global){
         if(init_val != nullptr){
-            init_val->getInitVal(init, len, true);
+            init_val->getInitVal(init, 0, len, 0, true);
         }
-        ks.globalAllocArray(name, array_type, ks.getInitList(init, len));
+        sym->addr = irb.createGlobalAlloc(name, array_type, getInitList(init, len));
     } else {
-        ks.alloc(name, array_type);
-        if(init_val == nullptr) 
-            return;
-        init_val->getInitVal(init, len, false);
-
-        initArray(name, init, len);
+        Value *arr = irb.createAlloc(name, array_type);
+        sym->addr = arr;
+        if(init_val != nullptr){
+            init_val->getInitVal(init, 0, len, 0, false);
+            initLocalArray(arr, init, len);
+        }
     }
     return;
 }
 
-string InitValAST::Dump() const{
+Value *InitValAST::Dump() const{
     return exp->Dump();
 }
 
-void InitValAST::getInitVal(std::string *ptr, const std::vector<int> &len, bool is_global) const{
-    int n = len.size();
-    vector<int> width(n);
-    width[n - 1] = len[n - 1];
-    for(int i = n - 2; i >= 0; --i){
-        width[i] = width[i + 1] * len[i];
+void InitValAST::getInitVal(SparseInit<Value *> &init, int base, const std::vector<int> &len, size_t dim, bool is_global) const{
+    int n = len.size() - dim;   // 子数组的维数
+    vector<int> width(n);       // width[j]: 子数组第j维及以下的元素个数
+    width[n - 1] = len.back();
+    for(int j = n - 2; j >= 0; --j){
+        width[j] = width[j + 1] * len[dim + j];
     }
     int i = 0;  // 指向下一步要填写的内存位置
     for(auto &init_val : inits){
         if(init_val->tag == EXP){
+            Value *v;
             if(is_global){
-                ptr[i++] = to_string(init_val->exp->getValue());
+                v = irb.getInt(init_val->exp->getValue());
             } else{
-                ptr[i++] = init_val->Dump();
+                v = init_val->Dump();
             }
+            if(v != irb.getInt(0))
+                init.emplace_back(base + i, v);
+            ++i;
         } else {
             assert(n > 1);  // 对一维数组初始化不可能再套一个Aggregate{{}}
             int j = n - 1;
@@ -464,358 +543,309 @@ void InitValAST::getInitVal(std::string *ptr, const std::vector<int> &len, bool
                 assert(j < n - 1); // 保证整除最后一维
                 ++j;    // j 指向最大的可除的维度
             }
-            init_val->getInitVal(
-                ptr + i, 
-                vector<int>(len.begin() + j, len.end())
-                );
+            init_val->getInitVal(init, base + i, len, dim + j, is_global);
             i += width[j];
         }
         if(i >= width[0]) break;
     }
 }
 
-int ConstInitValAST::getValue(){
-    return const_exp->getValue();
-}
-
-// 对ptr指向的区域初始化，所指区域的数组类型由len规定
-void ConstInitValAST::getInitVal(std::string *ptr, const std::vector<int> &len) const{
-    int n = len.size();
-    vector<int> width(n);
-    width[n - 1] = len[n - 1];
-    for(int i = n - 2; i >= 0; --i){
-        width[i] = width[i + 1] * len[i];
-    }
-    int i = 0;  // 指向下一步要填写的内存位置
-    for(auto &init_val : inits){
-        if(init_val->tag == CONST_EXP){
-            ptr[i++] = to_string(init_val->getValue());
-        } else {
-            assert(n > 1);  // 对一维数组初始化不可能再套一个Aggregate{{}}
-            int j = n - 1;
-            if(i == 0){
-                j = 1;
-            } else{
-                j = n - 1;
-                for(; j >= 0; --j){
-                    if(i % width[j] != 0)
-                        break;
-                }
-                assert(j < n - 1); // 保证整除最后一维
-                ++j;    // j 指向最大的可除的维度
-            }
-            init_val->getInitVal(
-                ptr + i, 
-                vector<int>(len.begin() + j, len.end())
-                );
-            i += width[j];
-        }
-        if(i >= width[0]) break;
+Value *LValAST::Dump(bool dump_ptr)const{
+    vector<Value *> index;
+    for(auto &e: exps){
+        index.push_back(e->Dump());
     }
+    return Dump(index, dump_ptr);
 }
 
-string LValAST::Dump(bool dump_ptr)const{
+Value *LValAST::Dump(const vector<Value *> &index, bool dump_ptr)const{
+    SysYType *ty = sym->ty;
     if(tag == VARIABLE){
         // Hint: a single a ident be a array address
-        SysYType *ty = st.getType(ident);
         if(ty->ty == SysYType::SYSY_INT_CONST)
-            return to_string(st.getValue(ident));
+            return irb.getInt(sym->value);
         else if(ty->ty == SysYType::SYSY_INT){
             if(dump_ptr == false){
-                string tmp = st.getTmpName();
-                ks.load(tmp, st.getName(ident));
-                return tmp;
+                return irb.createLoad(sym->addr);
             } else {
-                return st.getName(ident);
+                return sym->addr;
             }
         } else {
             // func(ident)
             if(ty->value == -1){
-                string tmp = st.getTmpName();
-                ks.load(tmp, st.getName(ident));
-                return tmp;
+                return irb.createLoad(sym->addr);
             }
-            string tmp = st.getTmpName();
-            ks.getelemptr(tmp, st.getName(ident), "0");
-            return tmp;
+            return irb.createGetElemPtr(sym->addr, irb.getInt(0));
         }
     } else {
-        vector<string> index;
         vector<int> len;
-
-        for(auto &e: exps){
-            index.push_back(e->Dump());
-        }
-
-        SysYType *ty = st.getType(ident);
         ty->getArrayType(len);
 
         // hint: len可以是-1开头的，说明这个数组是函数中使用的参数
         // 如 a[-1][3][2],表明a是参数 a[][3][2], 即 *[3][2].
         // 此时第一步不能用getelemptr，而应该getptr
 
-        string name = st.getName(ident);
-        string tmp;
+        Value *addr = sym->addr;
+        Value *tmp;
         if(len.size() != 0 && len[0] == -1){
-            vector<int> sublen(len.begin() + 1, len.end());
-            string tmp_val = st.getTmpName();
-            ks.load(tmp_val, name);
-            string first_indexed = st.getTmpName();
-            ks.getptr(first_indexed, tmp_val, index[0]);
-            if(index.size() > 1){
-                tmp = getElemPtr(
-                    first_indexed,
-                    vector<string>(
-                        index.begin() + 1, index.end()
-                    )
-                );
-            } else {
-                tmp = first_indexed;
-            }
-            
+            Value *tmp_val = irb.createLoad(addr);
+            Value *first_indexed = irb.createGetPtr(tmp_val, index[0]);
+            tmp = getElemPtr(
+                first_indexed,
+                vector<Value *>(index.begin() + 1, index.end())
+            );
         } else {
-            tmp = getElemPtr(name, index);
+            tmp = getElemPtr(addr, index);
         }   
         
 
         if(index.size() < len.size()){
             // 一定是作为函数参数即实参使用，因为下标不完整
-            string real_param = st.getTmpName();
-            ks.getelemptr(real_param, tmp, "0");
-            return real_param;
+            return irb.createGetElemPtr(tmp, irb.getInt(0));
         }
         if(dump_ptr) return tmp;
-        string tmp2 = st.getTmpName();
-        ks.load(tmp2, tmp);
-        return tmp2;
+        return irb.createLoad(tmp);
     }
 }
 
-int LValAST::getValue(){
-    return st.getValue(ident);
+int LValAST::getValue(const vector<int> &index) const{
+    if(sym->ty->ty == SysYType::SYSY_INT_CONST)
+        return sym->value;
+    // 常量数组的元素，在展平的初值中的位置
+    vector<int> len;
+    sym->ty->getArrayType(len);
+    assert(index.size() == len.size());
+    int pos = 0;
+    for(size_t i = 0; i < len.size(); ++i)
+        pos = pos * len[i] + index[i];
+    auto it = lower_bound(sym->inits.begin(), sym->inits.end(), make_pair(pos, INT_MIN));
+    return it != sym->inits.end() && it->first == pos ? it->second : 0;
 }
 
 
-int ConstExpAST::getValue(){
-    return exp->getValue();
-}
-
-string ExpAST::Dump() const {
-    return l_or_exp->Dump();
-}
+/**
+ * 表达式的IR生成和常量求值同样用显式的栈做后序遍历，子表达式的结果放在值栈上。
+ * a+a+...+a 这样很长的表达式会形成很深的树，递归会栈溢出。
+*/
+namespace {
+struct ExpFrame{
+    const ExpAST *exp;
+    size_t phase;               // 已经处理完的子表达式个数
+    Value *result;              // 短路求值: 结果变量
+    BasicBlock *then_s, *end_s; // 短路求值: 计算右边的块和结束的块
+};
+}
+
+static ExpFrame expFrame(const ExpAST *exp){
+    return ExpFrame{exp, 0, nullptr, nullptr, nullptr};
+}
+
+// 从值栈上取出最后n个值
+template<typename T>
+static vector<T> popValues(vector<T> &vals, size_t n){
+    vector<T> res(vals.end() - n, vals.end());
+    vals.resize(vals.size() - n);
+    return res;
+}
+
+Value *ExpAST::Dump() const {
+    vector<ExpFrame> stk;
+    vector<Value *> vals;
+    stk.push_back(expFrame(this));
+    while(!stk.empty()){
+        ExpFrame &f = stk.back();
+        const ExpAST *e = f.exp;
+        switch(e->tag){
+        case NUMBER:
+            vals.push_back(irb.getInt(e->number));
+            break;
+        case LVAL:{
+            const auto &exps = e->lval->exps;
+            if(f.phase < exps.size()){
+                stk.push_back(expFrame(exps[f.phase++]));
+                continue;
+            }
+            vector<Value *> index = popValues(vals, exps.size());
+            vals.push_back(e->lval->Dump(index));
+            break;
+        }
+        case CALL:{
+            size_t n = e->func_params ? e->func_params->exps.size() : 0;
+            if(f.phase < n){
+                stk.push_back(expFrame(e->func_params->exps[f.phase++]));
+                continue;
+            }
+            vector<Value *> par = popValues(vals, n);
+            vals.push_back(irb.createCall(e->sym->func, par));
+            break;
+        }
+        case UNARY:
+            if(f.phase == 0){
+                f.phase = 1;
+                stk.push_back(expFrame(e->lhs));
+                continue;
+            }
+            vals.back() = irb.createBinary(e->op, irb.getInt(0), vals.back());
+            break;
+        case BINARY:
+            if(f.phase < 2){
+                const ExpAST *c = f.phase++ == 0 ? e->lhs : e->rhs;
+                stk.push_back(expFrame(c));
+                continue;
+            } else{
+                Value *b = vals.back();
+                vals.pop_back();
+                vals.back() = irb.createBinary(e->op, vals.back(), b);
+            }
+            break;
+        default:{
+            // 短路求值。&&的结果默认为0，左边为真才计算右边；||的结果默认为1，左边为假才计算右边
+            bool is_and = e->tag == AND;
+            if(f.phase == 0){
+                f.result = irb.createAlloc(st.getVarName("SCRES"), IRType::getInt32());
+                irb.createStore(irb.getInt(is_and ? 0 : 1), f.result);
+                f.phase = 1;
+                stk.push_back(expFrame(e->lhs));
+                continue;
+            }
+            if(f.phase == 1){
+                Value *l = vals.back();
+                vals.pop_back();
+                f.then_s = irb.createBlock(st.getLabelName("then_sc"));
+                f.end_s = irb.createBlock(st.getLabelName("end_sc"));
+                if(is_and)
+                    irb.createBranch(l, f.then_s, f.end_s);
+                else
+                    irb.createBranch(l, f.end_s, f.then_s);
+
+                bc.set();
+                irb.appendBlock(f.then_s);
+                f.phase = 2;
+                stk.push_back(expFrame(e->rhs));
+                continue;
+            }
+            Value *r = vals.back();
+            Value *tmp = irb.createBinary(Value::NE, r, irb.getInt(0));
+            irb.createStore(tmp, f.result);
+            irb.createJump(f.end_s);
 
-int ExpAST::getValue(){
-    return l_or_exp->getValue();
+            bc.set();
+            irb.appendBlock(f.end_s);
+            vals.back() = irb.createLoad(f.result);
+            break;
+        }
+        }
+        stk.pop_back();
+    }
+    return vals.back();
 }
 
-
-string PrimaryExpAST::Dump() const{
-    switch (tag)
-    {
-        case PARENTHESES:
-            return exp->Dump();
+/**
+ * 作为if/while条件的表达式直接翻译成跳转：为真跳到true_bb，为假跳到false_bb。
+ * a && b: a为真时才去算b，a为假直接跳到false_bb；a || b 反之；!a 交换两个目标。
+ * 不需要存放结果的变量，其余的表达式算出值后与0比较。
+ * 同样用显式的栈，then_s/end_s为这一帧为真、为假时的目标；
+ * exp为空的帧表示开始生成右操作数所在的基本块then_s。
+*/
+void ExpAST::DumpCond(BasicBlock *true_bb, BasicBlock *false_bb) const{
+    vector<ExpFrame> stk;
+    stk.push_back(ExpFrame{this, 0, nullptr, true_bb, false_bb});
+    while(!stk.empty()){
+        ExpFrame f = stk.back();
+        stk.pop_back();
+        const ExpAST *e = f.exp;
+        if(e == nullptr){
+            bc.set();
+            irb.appendBlock(f.then_s);
+            continue;
+        }
+        switch(e->tag){
+        case AND:
+        case OR:{
+            bool is_and = e->tag == AND;
+            BasicBlock *rhs_bb = irb.createBlock(st.getLabelName(is_and ? "then_sc" : "else_sc"));
+            stk.push_back(ExpFrame{e->rhs, 0, nullptr, f.then_s, f.end_s});
+            stk.push_back(ExpFrame{nullptr, 0, nullptr, rhs_bb, nullptr});
+            if(is_and)
+                stk.push_back(ExpFrame{e->lhs, 0, nullptr, rhs_bb, f.end_s});
+            else
+                stk.push_back(ExpFrame{e->lhs, 0, nullptr, f.then_s, rhs_bb});
+            break;
+        }
         case NUMBER:
-            return to_string(number);
-        case LVAL:
-            return lval->Dump();
+            irb.createJump(e->number != 0 ? f.then_s : f.end_s);
+            break;
+        default:
+            if(e->tag == UNARY && e->op == Value::EQ){
+                stk.push_back(ExpFrame{e->lhs, 0, nullptr, f.end_s, f.then_s});
+                break;
+            }
+            irb.createBranch(e->Dump(), f.then_s, f.end_s);
+            break;
+        }
     }
-    return "";
 }
 
-int PrimaryExpAST::getValue(){
-    switch (tag)
-    {
-        case PARENTHESES:
-            return exp->getValue();
+int ExpAST::getValue(){
+    vector<ExpFrame> stk;
+    vector<int> vals;
+    stk.push_back(expFrame(this));
+    while(!stk.empty()){
+        ExpFrame &f = stk.back();
+        const ExpAST *e = f.exp;
+        switch(e->tag){
         case NUMBER:
-            return number;
-        case LVAL:
-            return lval->getValue();
-    }
-    return -1;  // make g++ happy
-}
-
-string UnaryExpAST::Dump() const{
-    if(tag == PRIMARY_EXP)return primary_exp->Dump();
-    else if(tag == OP_UNITARY_EXP){
-        string b = unary_exp->Dump();
-        if(unary_op == '+') return b;
-
-        string op = unary_op == '-' ? "sub" : "eq";
-        string c = st.getTmpName();
-        ks.binary(op, c, "0", b);
-        return c;
-    }else{
-        // Func_Call
-        string name = st.getName(ident);
-        string tmp = "";
-        vector<string> par;
-        if(st.getType(ident)->ty == SysYType::SYSY_FUNC_INT){
-            tmp = st.getTmpName();
+            vals.push_back(e->number);
+            break;
+        case LVAL:{
+            const auto &exps = e->lval->exps;
+            if(f.phase < exps.size()){
+                stk.push_back(expFrame(exps[f.phase++]));
+                continue;
+            }
+            vector<int> index = popValues(vals, exps.size());
+            vals.push_back(e->lval->getValue(index));
+            break;
         }
-        if(func_params){
-            int n = func_params->exps.size();
-            for(int i = 0; i < n; ++i){
-                par.push_back(func_params->exps[i]->Dump());
+        case UNARY:
+            if(f.phase == 0){
+                f.phase = 1;
+                stk.push_back(expFrame(e->lhs));
+                continue;
+            }
+            vals.back() = e->op == Value::SUB ? -vals.back() : !vals.back();
+            break;
+        case BINARY:
+            if(f.phase < 2){
+                const ExpAST *c = f.phase++ == 0 ? e->lhs : e->rhs;
+                stk.push_back(expFrame(c));
+                continue;
+            } else{
+                int b = vals.back();
+                vals.pop_back();
+                vals.back() = foldBinary(e->op, vals.back(), b);
             }
+            break;
+        case AND:
+        case OR:
+            // 注意是逻辑与/或，左边已经能确定结果时不计算右边
+            if(f.phase == 0){
+                f.phase = 1;
+                stk.push_back(expFrame(e->lhs));
+                continue;
+            }
+            if(f.phase == 1 && (vals.back() != 0) == (e->tag == AND)){
+                vals.pop_back();
+                f.phase = 2;
+                stk.push_back(expFrame(e->rhs));
+                continue;
+            }
+            vals.back() = vals.back() != 0;
+            break;
+        default:
+            assert(false);  // 函数调用不是常量表达式
         }
-        ks.call(tmp, st.getName(ident), par);
-        return tmp;
-    }
-}
-
-int UnaryExpAST::getValue(){
-    if(tag == PRIMARY_EXP) return primary_exp->getValue();
-
-    int v =unary_exp->getValue();
-    if(unary_op == '+') return v;
-    return unary_op == '-' ? -v : !v;
-}
-
-string MulExpAST::Dump() const{
-    if(tag == UNARY_EXP)return unary_exp->Dump();
-    string a, b, c;
-    
-    a = mul_exp_1->Dump();
-    b = unary_exp_2->Dump();
-
-    string op = mul_op == '*' ? "mul":(mul_op == '/' ?"div" : "mod");
-    
-    c = st.getTmpName();
-    ks.binary(op, c, a, b);
-    return c;
-}
-
-int MulExpAST::getValue(){
-    if(tag == UNARY_EXP) return unary_exp->getValue();
-
-    int a = mul_exp_1->getValue(), b = unary_exp_2->getValue();
-
-    return mul_op == '*' ? a * b : (mul_op == '/' ? a / b : a % b);
-}
-
-string AddExpAST::Dump() const{
-    if(tag == MUL_EXP)return mul_exp->Dump();
-    string a, b, c;
-    
-    a = add_exp_1->Dump();
-    b = mul_exp_2->Dump();
-
-    string op = add_op == '+' ? "add" : "sub";
-    
-    c = st.getTmpName();
-    ks.binary(op, c, a, b);
-    return c;
-}
-
-int AddExpAST::getValue(){
-    if(tag == MUL_EXP) return mul_exp->getValue();
-
-    int a = add_exp_1->getValue(), b = mul_exp_2->getValue();
-    return add_op == '+' ? a + b : a - b;
-}
-
-string RelExpAST::Dump() const {
-    if(tag == ADD_EXP) return add_exp->Dump();
-    string a = rel_exp_1->Dump(), b = add_exp_2->Dump();
-    string op = rel_op[1] == '=' ? (rel_op[0] == '<' ? "le" : "ge") : (rel_op[0] == '<' ? "lt" : "gt");
-    string dest = st.getTmpName();
-    ks.binary(op, dest, a, b);
-    return dest;
-}
-
-int RelExpAST::getValue(){
-    if(tag == ADD_EXP) return add_exp->getValue();
-
-    int a = rel_exp_1->getValue(), b = add_exp_2->getValue();
-    if(rel_op[1] == '='){
-        return rel_op[0] == '>' ? (a >= b) : (a <= b);
+        stk.pop_back();
     }
-    return rel_op[0] == '>' ? (a > b) : (a < b);
-}
-
-string EqExpAST::Dump() const {
-    if(tag == REL_EXP) return rel_exp->Dump();
-    string a = eq_exp_1->Dump(), b =rel_exp_2->Dump();
-    string op = eq_op == '=' ? "eq" : "ne";
-    string dest = st.getTmpName();
-    ks.binary(op, dest, a, b);
-    return dest;
-}
-
-int EqExpAST::getValue(){
-    if(tag == REL_EXP) return rel_exp->getValue();
-    int a = eq_exp_1->getValue(), b = rel_exp_2->getValue();
-    return eq_op == '=' ? (a == b) : (a != b);
-}
-
-string LAndExpAST::Dump() const {
-    if(tag == EQ_EXP) return eq_exp->Dump();
-    
-    // 修改支持短路逻辑
-    string result = st.getVarName("SCRES");
-    ks.alloc(result);
-    ks.store("0", result);
-
-    string lhs = l_and_exp_1->Dump();
-    string then_s = st.getLabelName("then_sc");
-    string end_s = st.getLabelName("end_sc");
-
-    ks.br(lhs, then_s, end_s);
-
-    bc.set();
-    ks.label(then_s);
-    string rhs = eq_exp_2->Dump();
-    string tmp = st.getTmpName();
-    ks.binary("ne", tmp, rhs, "0");
-    ks.store(tmp, result);
-    ks.jump(end_s);
-
-    bc.set();
-    ks.label(end_s);
-    string ret = st.getTmpName();
-    ks.load(ret, result);
-    return ret;
-}
-
-int LAndExpAST::getValue(){
-    if(tag == EQ_EXP) return eq_exp->getValue();
-    int a = l_and_exp_1->getValue(), b = eq_exp_2->getValue();
-    return a && b;  // 注意是逻辑与
-}
-
-string LOrExpAST::Dump() const {
-    if(tag == L_AND_EXP) return l_and_exp->Dump();
-
-    // 修改支持短路逻辑
-    string result = st.getVarName("SCRES");
-    ks.alloc(result);
-    ks.store("1", result);
-
-    string lhs = l_or_exp_1->Dump();
-
-    string then_s = st.getLabelName("then_sc");
-    string end_s = st.getLabelName("end_sc");
-
-    ks.br(lhs, end_s, then_s);
-
-    bc.set();
-    ks.label(then_s);
-    string rhs = l_and_exp_2->Dump();
-    string tmp = st.getTmpName();
-    ks.binary("ne", tmp, rhs, "0");
-    ks.store(tmp, result);
-    ks.jump(end_s);
-
-    bc.set();
-    ks.label(end_s);
-    string ret = st.getTmpName();
-    ks.load(ret, result);
-    return ret;
+    return vals.back();
 }
-
-int LOrExpAST::getValue() {
-    if(tag == L_AND_EXP) return l_and_exp->getValue();
-    int a = l_or_exp_1->getValue(), b = l_and_exp_2->getValue();
-    return a || b;
-}
\ No newline at end of file
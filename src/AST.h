@@ -2,6 +2,10 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <functional>
+#include <cstring>
+#include "utils.h"
+#include "IR.h"
 // 所有类的声明
 class BaseAST; 
 class CompUnitAST;
@@ -25,54 +29,98 @@ class VarDefAST;
 class InitValAST;
 class ConstInitValAST;
 class LValAST;
-class ConstExpAST;
 class ArrayIndexConstExpList;
 class ArrayIndexExpList;
 
 // Expression
 class ExpAST;
-class PrimaryExpAST;
-class UnaryExpAST;
-class MulExpAST;
-class AddExpAST;
-class RelExpAST;
-class EqExpAST;
-class LAndExpAST;
-class LOrExpAST;
 
 class FuncRParamsAST;
 
+class Symbol;
+
+/**
+ * AST 的结点分配在 ast_arena 中，结点只含指针和数值，不需要析构。
+ * 标识符在词法分析时就换成了驻留的编号(见 IdentTable)。每处理完一个顶层定义，整个内存池一起回收。
+*/
+extern BumpArena ast_arena;
+
+template<typename T>
+T *newAST(){
+    return ast_arena.create<T>();
+}
+
+// 存放在 ast_arena 中的数组，只能在末尾追加。扩容后旧的空间随内存池一起回收
+template<typename T>
+class ASTList{
+private:
+    T *data;
+    unsigned len, cap;
+public:
+    ASTList(): data(nullptr), len(0), cap(0){}
+    void push_back(const T &v){
+        if(len == cap){
+            cap = cap ? cap * 2 : 4;
+            T *p = static_cast<T *>(ast_arena.allocate(sizeof(T) * cap, alignof(T)));
+            if(len) memcpy(p, data, sizeof(T) * len);
+            data = p;
+        }
+        data[len++] = v;
+    }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    T &operator[](size_t i) { return data[i]; }
+    const T &operator[](size_t i) const { return data[i]; }
+    T &back() { return data[len - 1]; }
+    T *begin() { return data; }
+    T *end() { return data + len; }
+    const T *begin() const { return data; }
+    const T *end() const { return data + len; }
+};
+
+// 稀疏的数组初值：按展平后的下标递增排列的非零元素，没有列出的元素都是0
+template<typename T>
+using SparseInit = std::vector<std::pair<int, T>>;
+
 // 所有 AST 的基类
 class BaseAST {
 public:
-    virtual ~BaseAST() = default;
     // 完成LR的打印，并返回计算结果（临时变量或立即数）所在的变量
     // 删掉了，不用多态。
     // virtual std::string Dump() const = 0;
 };
 
+// 每生成完一个全局变量或函数的IR就调用，完成优化、代码生成和输出，函数体由回调负责释放。由main设置
+extern std::function<void(Value *)> onGlobalVar;
+extern std::function<void(Function *)> onFunction;
+
 // CompUnit 是 BaseAST
+// 编译单元不保存顶层的声明和定义：语法分析每归约出一个，就立即生成IR并交给回调，
+// 之后这部分AST和IR都被释放，内存占用只与最大的函数有关
 class CompUnitAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<FuncDefAST>> func_defs;
-    std::vector<std::unique_ptr<DeclAST>> decls;
-    void Dump()const;
-    void DumpGlobalVar() const;
+    void Begin() const;
+    // 先做语义分析(Bind)，再生成IR(Dump)
+    void DumpDecl(DeclAST *decl) const;
+    void DumpFuncDef(FuncDefAST *func_def) const;
+    void End() const;
 };
 
 // FuncDef 也是 BaseAST
 class FuncDefAST : public BaseAST {
 public:
-    std::unique_ptr<BTypeAST> btype;    // 返回值类型
-    std::string ident;                  // 函数名标识符
-    std::unique_ptr<FuncFParamsAST> func_params;    // 函数参数, nullptr则无参数
-    std::unique_ptr<BlockAST> block;    // 函数体
+    BTypeAST *btype = nullptr;    // 返回值类型
+    int ident;                    // 函数名标识符
+    FuncFParamsAST *func_params = nullptr;    // 函数参数, nullptr则无参数
+    BlockAST *block = nullptr;    // 函数体
+    Symbol *sym = nullptr;        // 语义分析时绑定的符号
+    void Bind();
     void Dump() const;
 };
 
 class FuncFParamsAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<FuncFParamAST>> func_f_params;
+    ASTList<FuncFParamAST *> func_f_params;
     void Dump() const;
 };
 
@@ -81,36 +129,37 @@ class FuncFParamAST : public BaseAST {
 public:
     enum TAG { VARIABLE, ARRAY };
     TAG tag;
-    std::unique_ptr<BTypeAST> btype;
-    std::string ident;
-    std::vector<std::unique_ptr<ConstExpAST>> const_exps;   // a[][3]
-    std::string Dump() const; // 返回参数类型，如i32, *[i32, 4]
-    void getIndex(std::vector<int> &len);
+    BTypeAST *btype = nullptr;
+    int ident;
+    ASTList<ExpAST *> const_exps;   // a[][3]
+    Symbol *sym = nullptr;
+    IRType *Bind();     // 返回参数类型，如i32, *[i32, 4]
 };
 
 
 // Block 也是 BaseAST
 class BlockAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<BlockItemAST>> block_items;
-    void Dump(bool new_symbol_tb = true) const;
+    ASTList<BlockItemAST *> block_items;
+    void Bind(bool new_symbol_tb = true);
+    void Dump() const;
 };
 
 class BlockItemAST : public BaseAST {
 public:
     enum TAG {DECL, STMT};
     TAG tag;
-    std::unique_ptr<DeclAST> decl;
-    std::unique_ptr<StmtAST> stmt;
-    void Dump() const;
+    DeclAST *decl = nullptr;
+    StmtAST *stmt = nullptr;
 };
 
 class DeclAST : public BaseAST {
 public:
     enum TAG {CONST_DECL, VAR_DECL};
     TAG tag;
-    std::unique_ptr<ConstDeclAST> const_decl;
-    std::unique_ptr<VarDeclAST> var_decl;
+    ConstDeclAST *const_decl = nullptr;
+    VarDeclAST *var_decl = nullptr;
+    void Bind();
     void Dump() const;
 };
 
@@ -129,26 +178,26 @@ public:
     */
     enum TAG {RETURN, ASSIGN, BLOCK, EXP, WHILE, BREAK, CONTINUE, IF};
     TAG tag;
-    std::unique_ptr<ExpAST> exp;
-    std::unique_ptr<LValAST> lval;
-    std::unique_ptr<BlockAST> block;
-    std::unique_ptr<StmtAST> stmt;
-    std::unique_ptr<StmtAST> if_stmt;
-    std::unique_ptr<StmtAST> else_stmt;
+    ExpAST *exp = nullptr;
+    LValAST *lval = nullptr;
+    BlockAST *block = nullptr;
+    StmtAST *stmt = nullptr;
+    StmtAST *if_stmt = nullptr;
+    StmtAST *else_stmt = nullptr;
     void Dump() const;
 };
 
 class ConstDeclAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<ConstDefAST>> const_defs;
-    std::unique_ptr<BTypeAST> btype;
+    ASTList<ConstDefAST *> const_defs;
+    BTypeAST *btype = nullptr;
     void Dump() const;
 };
 
 class VarDeclAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<VarDefAST>> var_defs;
-    std::unique_ptr<BTypeAST> btype;
+    ASTList<VarDefAST *> var_defs;
+    BTypeAST *btype = nullptr;
     void Dump() const;
 };
 
@@ -156,16 +205,17 @@ class BTypeAST : public BaseAST {
 public:
     enum TAG {VOID, INT};
     TAG tag;
-    void Dump() const;
 };
 
 class ConstDefAST : public BaseAST {
 public:
     enum TAG { VARIABLE, ARRAY };
     TAG tag;
-    std::string ident;
-    std::vector<std::unique_ptr<ConstExpAST>> const_exps;   // size !=0, Array
-    std::unique_ptr<ConstInitValAST> const_init_val;
+    int ident;
+    ASTList<ExpAST *> const_exps;   // size !=0, Array
+    ConstInitValAST *const_init_val = nullptr;
+    Symbol *sym = nullptr;
+    void Bind();
     void Dump(bool is_global = false) const;
     void DumpArray(bool is_global = false) const;
 };
@@ -174,9 +224,11 @@ class VarDefAST: public BaseAST {
 public:
     enum TAG { VARIABLE, ARRAY };
     TAG tag;
-    std::string ident;
-    std::vector<std::unique_ptr<ConstExpAST>> const_exps;   // size != 0, Array
-    std::unique_ptr<InitValAST> init_val;   // nullptr implies no init_val
+    int ident;
+    ASTList<ExpAST *> const_exps;   // size != 0, Array
+    InitValAST *init_val = nullptr;   // nullptr implies no init_val
+    Symbol *sym = nullptr;
+    void Bind();
     void Dump(bool is_global = false) const;
     void DumpArray(bool is_global = false) const;
 };
@@ -185,21 +237,22 @@ class InitValAST : public BaseAST{
 public:
     enum TAG { EXP, INIT_LIST};
     TAG tag;
-    std::unique_ptr<ExpAST> exp;
-    std::vector<std::unique_ptr<InitValAST>> inits; // can be 0, 1, 2,....
-    std::string Dump() const;
-    void getInitVal(std::string *ptr, const std::vector<int> &len, bool is_global = false) const;
+    ExpAST *exp = nullptr;
+    ASTList<InitValAST *> inits; // can be 0, 1, 2,....
+    void Bind();
+    Value *Dump() const;
+    // 子数组第一个元素展平后的下标为base，类型为len的第dim维及以下
+    void getInitVal(SparseInit<Value *> &init, int base, const std::vector<int> &len, size_t dim, bool is_global = false) const;
 };
 
 class ConstInitValAST : public BaseAST {
 public:
     enum TAG { CONST_EXP, CONST_INIT_LIST };
     TAG tag;
-    std::unique_ptr<ConstExpAST> const_exp;
-    std::vector<std::unique_ptr<ConstInitValAST>> inits;    // size can be 0, 1, ...
-    // 表达式求值，计算结果放在pi所指的int内存地址
-    int getValue();
-    void getInitVal(std::string *ptr, const std::vector<int> &len) const;
+    ExpAST *const_exp = nullptr;
+    ASTList<ConstInitValAST *> inits;    // size can be 0, 1, ...
+    // 常量数组初值求值，非零的元素依次加入init
+    void getInitVal(SparseInit<int> &init, int base, const std::vector<int> &len, size_t dim) const;
 };
 
 
@@ -207,149 +260,49 @@ class LValAST : public BaseAST {
 public:
     enum TAG { VARIABLE, ARRAY };
     TAG tag;
-    std::string ident;
-    std::vector<std::unique_ptr<ExpAST>> exps;      // exps.size() != 0 implies ARRAY
-    std::string Dump(bool dump_ptr = false) const;   // 默认返回的是i32而非指针。
-    int getValue();
-};
-
-class ConstExpAST : public BaseAST {
-public:
-    std::unique_ptr<ExpAST> exp;
-    int getValue();
+    int ident;
+    ASTList<ExpAST *> exps;      // exps.size() != 0 implies ARRAY
+    Symbol *sym = nullptr;       // 语义分析时绑定的符号
+    Value *Dump(bool dump_ptr = false) const;   // 默认返回的是i32而非指针。
+    Value *Dump(const std::vector<Value *> &index, bool dump_ptr = false) const;  // 下标已经计算好
+    int getValue(const std::vector<int> &index) const;  // 常量或常量数组的元素
 };
 
 class ArrayIndexConstExpList : public BaseAST {
 public:
-    std::vector<std::unique_ptr<ConstExpAST>> const_exps;
+    ASTList<ExpAST *> const_exps;
 };
 
 class ArrayIndexExpList : public BaseAST {
 public:
-    std::vector<std::unique_ptr<ExpAST>> exps;
-};
-
-
-class ConstExpListAST: public BaseAST {
-public:
-    std::vector<std::unique_ptr<ConstExpAST>> const_exps;
+    ASTList<ExpAST *> exps;
 };
 
-class ExpListAST: public BaseAST {
-public:
-    std::vector<std::unique_ptr<ExpAST>> exps;
-    int getValue();
-};
-
-
-// Exp
+/**
+ * 表达式。各级运算符只在语法分析中体现优先级，生成的都是这一种结点：
+ * 叶子(数字、左值、函数调用)、一元运算、二元运算，以及短路求值的 && 和 ||。
+ * 一元的 + 和括号不产生结点。
+*/
 class ExpAST : public BaseAST {
 public:
-    std::unique_ptr<LOrExpAST> l_or_exp;
-    std::string Dump() const;
-    int getValue();
-};
-
-class PrimaryExpAST : public BaseAST {
-public:
-    enum TAG { PARENTHESES, NUMBER, LVAL};
-    TAG tag;
-    std::unique_ptr<ExpAST> exp;
-    std::unique_ptr<LValAST> lval;
-    int number;
-    std::string Dump() const ;
-    int getValue();
-};
-
-
-class UnaryExpAST : public BaseAST {
-public:
-    enum TAG { PRIMARY_EXP, OP_UNITARY_EXP, FUNC_CALL};
-    TAG tag;
-    std::unique_ptr<PrimaryExpAST> primary_exp;
-    char unary_op;
-    std::unique_ptr<UnaryExpAST> unary_exp;
-    std::string ident;
-    std::unique_ptr<FuncRParamsAST> func_params;
-    std::string Dump() const;
-    int getValue();
-};
-
-// MulExp
-class MulExpAST : public BaseAST {
-public:
-    enum TAG {UNARY_EXP, OP_MUL_EXP};
-    TAG tag;
-    std::unique_ptr<UnaryExpAST> unary_exp;
-    std::unique_ptr<MulExpAST> mul_exp_1;
-    std::unique_ptr<UnaryExpAST> unary_exp_2;
-    char mul_op;
-    std::string Dump() const;
-    int getValue();
-};
-
-// AddExp
-class AddExpAST : public BaseAST {
-public:
-    enum TAG {MUL_EXP, OP_ADD_EXP};
-    TAG tag;
-    std::unique_ptr<MulExpAST> mul_exp;
-    std::unique_ptr<AddExpAST> add_exp_1;
-    std::unique_ptr<MulExpAST> mul_exp_2;
-    char add_op;
-    std::string Dump() const;
-    int getValue();
-};
-
-// RelExp
-class RelExpAST : public BaseAST {
-public:
-    enum TAG {ADD_EXP, OP_REL_EXP};
-    TAG tag;
-    std::unique_ptr<AddExpAST> add_exp;
-    std::unique_ptr<RelExpAST> rel_exp_1;
-    std::unique_ptr<AddExpAST> add_exp_2;
-    char rel_op[2];     // <,>,<=,>=
-    std::string Dump() const;
-    int getValue();
-};
-
-class EqExpAST : public BaseAST {
-public:
-    enum TAG {REL_EXP, OP_EQ_EXP};
-    TAG tag;
-    std::unique_ptr<RelExpAST> rel_exp;
-    std::unique_ptr<EqExpAST> eq_exp_1;
-    std::unique_ptr<RelExpAST> rel_exp_2;
-    char eq_op;     // =,!
-    std::string Dump() const;
-    int getValue();
-};
-
-class LAndExpAST : public BaseAST {
-public:
-    enum TAG {EQ_EXP, OP_L_AND_EXP};
-    TAG tag;
-    std::unique_ptr<EqExpAST> eq_exp;
-    std::unique_ptr<LAndExpAST> l_and_exp_1;
-    std::unique_ptr<EqExpAST> eq_exp_2;
-    std::string Dump() const;
-    int getValue();
-};
-
-class LOrExpAST : public BaseAST {
-public:
-    enum TAG {L_AND_EXP, OP_L_OR_EXP};
+    enum TAG { NUMBER, LVAL, CALL, UNARY, BINARY, AND, OR };
     TAG tag;
-    std::unique_ptr<LAndExpAST> l_and_exp;
-    std::unique_ptr<LOrExpAST> l_or_exp_1;
-    std::unique_ptr<LAndExpAST> l_and_exp_2;
-    std::string Dump() const;
+    Value::OP op;                   // UNARY: SUB 为取负，EQ 为逻辑非；BINARY: 运算符
+    ExpAST *lhs = nullptr;          // UNARY 的操作数，BINARY/AND/OR 的左操作数
+    ExpAST *rhs = nullptr;          // BINARY/AND/OR 的右操作数
+    int number;                     // NUMBER
+    LValAST *lval = nullptr;        // LVAL
+    int ident;                      // CALL 的函数名
+    FuncRParamsAST *func_params = nullptr;  // CALL 的实参, nullptr则无参数
+    Symbol *sym = nullptr;          // CALL 绑定的函数
+    void Bind();                    // 绑定其中的左值和函数调用
+    Value *Dump() const;
+    void DumpCond(BasicBlock *true_bb, BasicBlock *false_bb) const;    // 作为条件，直接生成跳转
     int getValue();
 };
 
 class FuncRParamsAST : public BaseAST {
 public:
-    std::vector<std::unique_ptr<ExpAST>> exps;
-    std::string Dump() const;
+    ASTList<ExpAST *> exps;
+    Value *Dump() const;
 };
@@ -0,0 +1,756 @@
+#include "IR.h"
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_set>
+using namespace std;
+
+/**
+ * IRType
+*/
+
+IRType *IRType::getInt32(){
+    static IRType ty(INT32);
+    return &ty;
+}
+
+IRType *IRType::getUnit(){
+    static IRType ty(UNIT);
+    return &ty;
+}
+
+IRType *IRType::getPointer(IRType *base){
+    static unordered_map<IRType *, unique_ptr<IRType>> pool;
+    auto &p = pool[base];
+    if(!p) p.reset(new IRType(POINTER, base));
+    return p.get();
+}
+
+IRType *IRType::getArray(IRType *base, int len){
+    static map<pair<IRType *, int>, unique_ptr<IRType>> pool;
+    auto &p = pool[make_pair(base, len)];
+    if(!p) p.reset(new IRType(ARRAY, base, len));
+    return p.get();
+}
+
+IRType *IRType::getArray(const vector<int> &len){
+    IRType *ty = getInt32();
+    for(int i = len.size() - 1; i >= 0; --i)
+        ty = getArray(ty, len[i]);
+    return ty;
+}
+
+int IRType::getSize() const{
+    switch(tag){
+        case INT32:
+        case POINTER:
+            return 4;
+        case ARRAY:
+            return len * base->getSize();
+        default:
+            return 0;
+    }
+}
+
+void IRType::print(KoopaString &ks) const{
+    switch(tag){
+        case INT32:
+            ks.append("i32");
+            break;
+        case POINTER:
+            ks.append('*');
+            base->print(ks);
+            break;
+        case ARRAY:
+            ks.append('[');
+            base->print(ks);
+            ks.append(", ");
+            ks.appendInt(len);
+            ks.append(']');
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Value
+*/
+
+Value::Value(TAG _t, IRType *_ty): tag(_t), ty(_ty), bb(nullptr), value(0), op(ADD),
+    callee(nullptr), n_true_args(0){
+    target[0] = target[1] = nullptr;
+}
+
+// 把ops[i]记到它的users中
+void Value::linkUse(int i){
+    Value *v = ops[i];
+    if(v->isConst()){
+        use_pos[i] = -1;
+        return;
+    }
+    use_pos[i] = v->users.size();
+    v->users.push_back(this);
+    v->user_slot.push_back(i);
+}
+
+// 从ops[i]的users中去掉这一次使用：用最后一项填补空位，并更新被移动的那一项的use_pos
+void Value::unlinkUse(int i){
+    int p = use_pos[i];
+    if(p < 0) return;
+    Value *v = ops[i];
+    Value *u = v->users.back();
+    int s = v->user_slot.back();
+    v->users[p] = u;
+    v->user_slot[p] = s;
+    u->use_pos[s] = p;
+    v->users.pop_back();
+    v->user_slot.pop_back();
+}
+
+// ops中从i开始的操作数下标变了，更新它们在users中记录的位置
+void Value::relinkUses(int i){
+    for(int k = i; k < (int)ops.size(); ++k){
+        if(use_pos[k] >= 0)
+            ops[k]->user_slot[use_pos[k]] = k;
+    }
+}
+
+void Value::addOperand(Value *v){
+    ops.push_back(v);
+    use_pos.push_back(-1);
+    linkUse(ops.size() - 1);
+}
+
+void Value::setOperand(int i, Value *v){
+    unlinkUse(i);
+    ops[i] = v;
+    linkUse(i);
+}
+
+void Value::dropOperands(){
+    for(size_t i = 0; i < ops.size(); ++i)
+        unlinkUse(i);
+    ops.clear();
+    use_pos.clear();
+}
+
+void Value::replaceAllUsesWith(Value *v){
+    // 一个user以this为操作数几次，就在users中出现几次，去重后逐个替换
+    vector<Value *> us;
+    us.swap(users);
+    user_slot.clear();
+    sort(us.begin(), us.end());
+    us.erase(unique(us.begin(), us.end()), us.end());
+    for(auto u : us){
+        for(size_t i = 0; i < u->ops.size(); ++i){
+            if(u->ops[i] == this){
+                u->ops[i] = v;
+                u->linkUse(i);
+            }
+        }
+    }
+}
+
+int Value::argBegin(int k) const{
+    if(tag == JUMP) return 0;
+    return k == 0 ? 1 : 1 + n_true_args;
+}
+
+int Value::argEnd(int k) const{
+    if(tag == JUMP) return ops.size();
+    return k == 0 ? 1 + n_true_args : ops.size();
+}
+
+void Value::addArg(int k, Value *v){
+    if(tag == BRANCH && k == 0){
+        int p = 1 + n_true_args;
+        ops.insert(ops.begin() + p, v);
+        use_pos.insert(use_pos.begin() + p, -1);
+        ++n_true_args;
+        linkUse(p);
+        relinkUses(p + 1);
+    } else {
+        addOperand(v);
+    }
+}
+
+void Value::removeArg(int k, int i){
+    int p = argBegin(k) + i;
+    unlinkUse(p);
+    ops.erase(ops.begin() + p);
+    use_pos.erase(use_pos.begin() + p);
+    relinkUses(p);
+    if(tag == BRANCH && k == 0)
+        --n_true_args;
+}
+
+vector<Value *> Value::getArgs(int k) const{
+    return vector<Value *>(ops.begin() + argBegin(k), ops.begin() + argEnd(k));
+}
+
+Value *mapValue(const unordered_map<Value *, Value *> &vmap, Value *v){
+    auto it = vmap.find(v);
+    return it == vmap.end() ? v : it->second;
+}
+
+int foldBinary(Value::OP op, int a, int b){
+    unsigned ua = a, ub = b;
+    switch(op){
+        case Value::NE: return a != b;
+        case Value::EQ: return a == b;
+        case Value::GT: return a > b;
+        case Value::LT: return a < b;
+        case Value::GE: return a >= b;
+        case Value::LE: return a <= b;
+        case Value::ADD: return (int)(ua + ub);
+        case Value::SUB: return (int)(ua - ub);
+        case Value::MUL: return (int)(ua * ub);
+        case Value::DIV:
+            if(b == 0) return -1;
+            if(a == INT32_MIN && b == -1) return a;
+            return a / b;
+        case Value::MOD:
+            if(b == 0) return a;
+            if(a == INT32_MIN && b == -1) return 0;
+            return a % b;
+        case Value::AND: return a & b;
+        case Value::OR: return a | b;
+        case Value::XOR: return a ^ b;
+        case Value::SHL: return (int)(ua << (ub & 31));
+        case Value::SHR: return (int)(ua >> (ub & 31));
+        case Value::SAR: return a >> (b & 31);
+    }
+    return 0;
+}
+
+/**
+ * BasicBlock, Function
+*/
+
+Value *BasicBlock::getTerminator() const{
+    if(insts.empty() || !insts.back()->isTerminator())
+        return nullptr;
+    return insts.back();
+}
+
+vector<BasicBlock *> BasicBlock::getSuccs() const{
+    vector<BasicBlock *> succs;
+    Value *t = getTerminator();
+    if(t == nullptr) return succs;
+    if(t->tag == Value::JUMP){
+        succs.push_back(t->target[0]);
+    } else if(t->tag == Value::BRANCH){
+        succs.push_back(t->target[0]);
+        if(t->target[1] != t->target[0])
+            succs.push_back(t->target[1]);
+    }
+    return succs;
+}
+
+void Function::buildCFG(){
+    for(auto bb : bbs)
+        bb->preds.clear();
+    for(auto bb : bbs){
+        for(auto s : bb->getSuccs())
+            s->preds.push_back(bb);
+    }
+}
+
+vector<BasicBlock *> Function::getRPO() const{
+    vector<BasicBlock *> post;
+    if(bbs.empty()) return post;
+    unordered_set<BasicBlock *> visited;
+    // 显式栈上的DFS，(基本块, 下一个要访问的后继下标)
+    vector<pair<BasicBlock *, size_t>> stk;
+    vector<vector<BasicBlock *>> succs;
+    stk.emplace_back(bbs[0], 0);
+    succs.push_back(bbs[0]->getSuccs());
+    visited.insert(bbs[0]);
+    while(!stk.empty()){
+        auto &top = stk.back();
+        auto &ss = succs.back();
+        if(top.second < ss.size()){
+            BasicBlock *s = ss[top.second++];
+            if(visited.insert(s).second){
+                stk.emplace_back(s, 0);
+                succs.push_back(s->getSuccs());
+            }
+        } else {
+            post.push_back(top.first);
+            stk.pop_back();
+            succs.pop_back();
+        }
+    }
+    reverse(post.begin(), post.end());
+    return post;
+}
+
+int Function::removeUnreachable(){
+    auto rpo = getRPO();
+    if(rpo.size() == bbs.size()) return 0;
+    unordered_set<BasicBlock *> reachable(rpo.begin(), rpo.end());
+    vector<BasicBlock *> live;
+    for(auto bb : bbs){
+        if(reachable.count(bb)){
+            live.push_back(bb);
+        } else {
+            for(auto v : bb->insts)
+                v->dropOperands();
+        }
+    }
+    int removed = bbs.size() - live.size();
+    bbs.swap(live);
+    return removed;
+}
+
+int Function::mergeBlocks(){
+    buildCFG();
+    unordered_set<BasicBlock *> merged;
+    for(auto bb : bbs){
+        if(merged.count(bb)) continue;
+        while(true){
+            Value *term = bb->getTerminator();
+            if(term == nullptr || term->tag != Value::JUMP) break;
+            BasicBlock *s = term->target[0];
+            if(s == bb || s == bbs[0] || s->preds.size() != 1) break;
+            // 参数换成实参，指令移到bb末尾
+            for(size_t i = 0; i < s->params.size(); ++i)
+                s->params[i]->replaceAllUsesWith(term->ops[i]);
+            term->dropOperands();
+            bb->insts.pop_back();
+            for(auto v : s->insts)
+                v->bb = bb;
+            bb->insts.splice(bb->insts.end(), s->insts);
+            for(auto succ : bb->getSuccs()){
+                for(auto &p : succ->preds){
+                    if(p == s) p = bb;
+                }
+            }
+            merged.insert(s);
+        }
+    }
+    if(merged.empty()) return 0;
+    vector<BasicBlock *> live;
+    for(auto bb : bbs){
+        if(!merged.count(bb))
+            live.push_back(bb);
+    }
+    bbs.swap(live);
+    return merged.size();
+}
+
+Value *Function::newValue(Value::TAG tag, IRType *ty){
+    return values.create(tag, ty);
+}
+
+BasicBlock *Function::newBasicBlock(const string &name){
+    return blocks.create(name, this);
+}
+
+Value *Function::cloneValue(const Value *v, const unordered_map<Value *, Value *> &vmap){
+    Value *c = newValue(v->tag, v->ty);
+    c->value = v->value;
+    c->op = v->op;
+    c->callee = v->callee;
+    c->target[0] = v->target[0];
+    c->target[1] = v->target[1];
+    c->n_true_args = v->n_true_args;
+    for(auto o : v->ops)
+        c->addOperand(mapValue(vmap, o));
+    return c;
+}
+
+void Function::releaseBody(){
+    // 函数体外的value不再被函数体中的指令使用
+    for(auto g : program->globals){
+        size_t n = 0;
+        for(size_t j = 0; j < g->users.size(); ++j){
+            Value *u = g->users[j];
+            if(u->bb->func == this) continue;
+            g->users[n] = u;
+            g->user_slot[n] = g->user_slot[j];
+            u->use_pos[g->user_slot[n]] = n;
+            ++n;
+        }
+        g->users.resize(n);
+        g->user_slot.resize(n);
+    }
+    for(auto p : params){
+        p->users.clear();
+        p->user_slot.clear();
+    }
+    bbs.clear();
+    blocks.clear();
+    values.clear();
+}
+
+/**
+ * Program
+*/
+
+Value *Program::newValue(Value::TAG tag, IRType *ty){
+    return values.create(tag, ty);
+}
+
+Function *Program::newFunction(const string &name, IRType *ret){
+    return functions.create(name, ret, this);
+}
+
+Value *Program::getInt(int i){
+    auto &v = integers[i];
+    if(v == nullptr){
+        v = newValue(Value::INTEGER, IRType::getInt32());
+        v->value = i;
+    }
+    return v;
+}
+
+Value *Program::getZeroInit(IRType *ty){
+    auto &v = zero_inits[ty];
+    if(v == nullptr)
+        v = newValue(Value::ZERO_INIT, ty);
+    return v;
+}
+
+Value *Program::getUndef(IRType *ty){
+    auto &v = undefs[ty];
+    if(v == nullptr)
+        v = newValue(Value::UNDEF, ty);
+    return v;
+}
+
+Value *Program::getAggregate(IRType *ty, const vector<Value *> &elems){
+    Value *v = newValue(Value::AGGREGATE, ty);
+    for(auto e : elems)
+        v->addOperand(e);
+    return v;
+}
+
+namespace {
+const char *op_names[] = {
+    "ne", "eq", "gt", "lt", "ge", "le", "add", "sub", "mul",
+    "div", "mod", "and", "or", "xor", "shl", "shr", "sar"
+};
+
+// 打印时给没有名字的value编号
+class NameTable{
+private:
+    unordered_map<const Value *, int> names;
+    int cnt = 0;
+public:
+
+    void define(const Value *v){
+        if(v->name.empty())
+            names[v] = cnt++;
+    }
+
+    void print(KoopaString &ks, const Value *v){
+        switch(v->tag){
+            case Value::INTEGER:
+                ks.appendInt(v->value);
+                return;
+            case Value::ZERO_INIT:
+                ks.append("zeroinit");
+                return;
+            case Value::UNDEF:
+                ks.append("undef");
+                return;
+            case Value::AGGREGATE:
+                ks.append('{');
+                for(size_t i = 0; i < v->ops.size(); ++i){
+                    if(i) ks.append(", ");
+                    print(ks, v->ops[i]);
+                }
+                ks.append('}');
+                return;
+            default:
+                break;
+        }
+        if(!v->name.empty()){
+            ks.append(v->name);
+        } else {
+            ks.append('%');
+            ks.appendInt(names[v]);
+        }
+    }
+
+    // 跳转目标及其参数，如 %while_entry_0(%1, 0)
+    void target(KoopaString &ks, const Value *t, int k){
+        ks.append(t->target[k]->name);
+        int b = t->argBegin(k), e = t->argEnd(k);
+        if(b == e) return;
+        ks.append('(');
+        for(int i = b; i < e; ++i){
+            if(i != b) ks.append(", ");
+            print(ks, t->ops[i]);
+        }
+        ks.append(')');
+    }
+
+    // 参数列表，如 (%0: i32, @a: *i32)。decl只打印类型
+    void params(KoopaString &ks, const vector<Value *> &ps, bool with_name){
+        ks.append('(');
+        for(size_t i = 0; i < ps.size(); ++i){
+            if(i) ks.append(", ");
+            if(with_name){
+                print(ks, ps[i]);
+                ks.append(": ");
+            }
+            ps[i]->ty->print(ks);
+        }
+        ks.append(')');
+    }
+
+    // 形如 "  %1 = op " 的指令开头
+    void def(KoopaString &ks, const Value *v, const char *op){
+        ks.append("  ");
+        print(ks, v);
+        ks.append(" = ");
+        ks.append(op);
+        ks.append(' ');
+    }
+};
+}
+
+void Program::dump(KoopaString &ks) const{
+    for(auto g : globals)
+        dumpGlobal(ks, g);
+    ks.append('\n');
+    for(auto f : funcs){
+        if(f->isDecl())
+            dumpFunction(ks, f);
+    }
+    ks.append('\n');
+    for(auto f : funcs){
+        if(!f->isDecl())
+            dumpFunction(ks, f);
+    }
+}
+
+void Program::dumpGlobal(KoopaString &ks, const Value *g){
+    NameTable nt;
+    ks.append("global ");
+    ks.append(g->name);
+    ks.append(" = alloc ");
+    g->ty->base->print(ks);
+    ks.append(", ");
+    nt.print(ks, g->ops[0]);
+    ks.append('\n');
+}
+
+void Program::dumpFunction(KoopaString &ks, const Function *f){
+    NameTable nt;
+    if(f->isDecl()){
+        ks.append("decl ");
+        ks.append(f->name);
+        nt.params(ks, f->params, false);
+        if(f->ret_ty->tag == IRType::INT32)
+            ks.append(": i32");
+        ks.append('\n');
+        return;
+    }
+    for(auto p : f->params)
+        nt.define(p);
+    for(auto bb : f->bbs){
+        for(auto p : bb->params)
+            nt.define(p);
+        for(auto v : bb->insts){
+            if(v->ty->tag != IRType::UNIT)
+                nt.define(v);
+        }
+    }
+    ks.append("fun ");
+    ks.append(f->name);
+    nt.params(ks, f->params, true);
+    if(f->ret_ty->tag == IRType::INT32)
+        ks.append(": i32");
+    ks.append(" {\n");
+
+    for(auto bb : f->bbs){
+        ks.append(bb->name);
+        if(!bb->params.empty())
+            nt.params(ks, bb->params, true);
+        ks.append(":\n");
+        for(auto v : bb->insts){
+            switch(v->tag){
+                case Value::ALLOC:
+                    nt.def(ks, v, "alloc");
+                    v->ty->base->print(ks);
+                    break;
+                case Value::LOAD:
+                    nt.def(ks, v, "load");
+                    nt.print(ks, v->ops[0]);
+                    break;
+                case Value::STORE:
+                    ks.append("  store ");
+                    nt.print(ks, v->ops[0]);
+                    ks.append(", ");
+                    nt.print(ks, v->ops[1]);
+                    break;
+                case Value::GET_PTR:
+                case Value::GET_ELEM_PTR:
+                case Value::BINARY:
+                    nt.def(ks, v, v->tag == Value::BINARY ? op_names[v->op] :
+                        v->tag == Value::GET_PTR ? "getptr" : "getelemptr");
+                    nt.print(ks, v->ops[0]);
+                    ks.append(", ");
+                    nt.print(ks, v->ops[1]);
+                    break;
+                case Value::BRANCH:
+                    ks.append("  br ");
+                    nt.print(ks, v->ops[0]);
+                    ks.append(", ");
+                    nt.target(ks, v, 0);
+                    ks.append(", ");
+                    nt.target(ks, v, 1);
+                    break;
+                case Value::JUMP:
+                    ks.append("  jump ");
+                    nt.target(ks, v, 0);
+                    break;
+                case Value::CALL:
+                    if(v->ty->tag == IRType::UNIT)
+                        ks.append("  call ");
+                    else
+                        nt.def(ks, v, "call");
+                    ks.append(v->callee->name);
+                    ks.append('(');
+                    for(size_t i = 0; i < v->ops.size(); ++i){
+                        if(i) ks.append(", ");
+                        nt.print(ks, v->ops[i]);
+                    }
+                    ks.append(')');
+                    break;
+                case Value::RETURN:
+                    ks.append("  ret");
+                    if(!v->ops.empty()){
+                        ks.append(' ');
+                        nt.print(ks, v->ops[0]);
+                    }
+                    break;
+                default:
+                    assert(false);
+            }
+            ks.append('\n');
+        }
+    }
+    ks.append("}\n\n");
+}
+
+/**
+ * IRBuilder
+*/
+
+IRBuilder::IRBuilder(): cur_bb(nullptr), program(new Program()), func(nullptr){}
+
+Function *IRBuilder::createFunction(const string &name, IRType *ret, const vector<IRType *> &param_tys,
+    const vector<string> &param_names){
+    Function *f = program->newFunction(name, ret);
+    for(size_t i = 0; i < param_tys.size(); ++i){
+        Value *p = program->newValue(Value::FUNC_ARG, param_tys[i]);
+        p->value = i;
+        if(i < param_names.size())
+            p->name = param_names[i];
+        f->params.push_back(p);
+    }
+    program->funcs.push_back(f);
+    func = f;
+    cur_bb = nullptr;
+    return f;
+}
+
+Value *IRBuilder::createGlobalAlloc(const string &name, IRType *ty, Value *init, bool read_only){
+    Value *v = program->newValue(Value::GLOBAL_ALLOC, IRType::getPointer(ty));
+    v->name = name;
+    v->value = read_only;
+    v->addOperand(init);
+    program->globals.push_back(v);
+    return v;
+}
+
+BasicBlock *IRBuilder::createBlock(const string &name){
+    return func->newBasicBlock(name);
+}
+
+void IRBuilder::appendBlock(BasicBlock *bb){
+    func->bbs.push_back(bb);
+    cur_bb = bb;
+}
+
+// 把新建的指令插入到当前基本块末尾
+static Value *insert(BasicBlock *bb, Value *v){
+    v->bb = bb;
+    bb->insts.push_back(v);
+    return v;
+}
+
+Value *IRBuilder::createAlloc(const string &name, IRType *ty){
+    Value *v = func->newValue(Value::ALLOC, IRType::getPointer(ty));
+    v->name = name;
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createLoad(Value *src){
+    Value *v = func->newValue(Value::LOAD, src->ty->base);
+    v->addOperand(src);
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createStore(Value *val, Value *dest){
+    Value *v = func->newValue(Value::STORE, IRType::getUnit());
+    v->addOperand(val);
+    v->addOperand(dest);
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createGetElemPtr(Value *src, Value *index){
+    Value *v = func->newValue(Value::GET_ELEM_PTR, IRType::getPointer(src->ty->base->base));
+    v->addOperand(src);
+    v->addOperand(index);
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createGetPtr(Value *src, Value *index){
+    Value *v = func->newValue(Value::GET_PTR, src->ty);
+    v->addOperand(src);
+    v->addOperand(index);
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createBinary(Value::OP op, Value *lhs, Value *rhs){
+    Value *v = func->newValue(Value::BINARY, IRType::getInt32());
+    v->op = op;
+    v->addOperand(lhs);
+    v->addOperand(rhs);
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createBranch(Value *cond, BasicBlock *t, BasicBlock *f){
+    Value *v = func->newValue(Value::BRANCH, IRType::getUnit());
+    v->addOperand(cond);
+    v->target[0] = t;
+    v->target[1] = f;
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createJump(BasicBlock *target){
+    Value *v = func->newValue(Value::JUMP, IRType::getUnit());
+    v->target[0] = target;
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createCall(Function *callee, const vector<Value *> &args){
+    Value *v = func->newValue(Value::CALL, callee->ret_ty);
+    v->callee = callee;
+    for(auto a : args)
+        v->addOperand(a);
+    return insert(cur_bb, v);
+}
+
+Value *IRBuilder::createReturn(Value *ret){
+    Value *v = func->newValue(Value::RETURN, IRType::getUnit());
+    if(ret != nullptr)
+        v->addOperand(ret);
+    return insert(cur_bb, v);
+}
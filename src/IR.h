@@ -0,0 +1,246 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <new>
+#include <utility>
+#include <unordered_map>
+#include <map>
+#include "utils.h"
+
+/**
+ * 编译器内部的中间表示，结构与 Koopa IR 一一对应。
+ * 前端遍历 AST 时通过 IRBuilder 直接构建它，优化 pass 在它上面进行，
+ * 后端直接遍历它生成 RISC-V，只有 -koopa 模式才打印成 Koopa IR 文本。
+ * 所有 Value/BasicBlock/Function 都分配在 Program 的内存池中，随 Program 一起释放。
+*/
+
+class IRType;
+class Value;
+class BasicBlock;
+class Function;
+class Program;
+
+// 按块分配同一类型对象的内存池。对象在池销毁时统一析构，不单独释放
+template<typename T, size_t CHUNK = 256>
+class Arena{
+private:
+    std::vector<T *> chunks;
+    size_t used;    // 最后一块已经用掉的个数
+public:
+    Arena(): used(CHUNK){}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena(){
+        clear();
+    }
+    // 析构所有对象并归还内存
+    void clear(){
+        for(size_t c = 0; c < chunks.size(); ++c){
+            size_t n = c + 1 == chunks.size() ? used : CHUNK;
+            for(size_t i = 0; i < n; ++i)
+                chunks[c][i].~T();
+            ::operator delete(chunks[c]);
+        }
+        chunks.clear();
+        used = CHUNK;
+    }
+    template<typename... Args>
+    T *create(Args &&... args){
+        if(used == CHUNK){
+            chunks.push_back(static_cast<T *>(::operator new(sizeof(T) * CHUNK)));
+            used = 0;
+        }
+        T *p = new(chunks.back() + used) T(std::forward<Args>(args)...);
+        ++used;
+        return p;
+    }
+};
+
+// 类型。相同的类型只有一个实例，可以直接比较指针
+class IRType{
+public:
+    enum TAG { INT32, UNIT, ARRAY, POINTER };
+    TAG tag;
+    IRType *base;   // ARRAY/POINTER 的元素类型
+    int len;        // ARRAY 的长度
+
+    IRType(TAG _t, IRType *_base = nullptr, int _len = 0): tag(_t), base(_base), len(_len){}
+    static IRType *getInt32();
+    static IRType *getUnit();
+    static IRType *getPointer(IRType *base);
+    static IRType *getArray(IRType *base, int len);
+    // 多维数组类型，如 len = {2, 3} 得到 [[i32, 3], 2]
+    static IRType *getArray(const std::vector<int> &len);
+    int getSize() const;
+    void print(KoopaString &ks) const;
+};
+
+class Value{
+public:
+    enum TAG {
+        INTEGER, ZERO_INIT, UNDEF, AGGREGATE,
+        FUNC_ARG, BLOCK_ARG,
+        ALLOC, GLOBAL_ALLOC, LOAD, STORE, GET_PTR, GET_ELEM_PTR, BINARY,
+        BRANCH, JUMP, CALL, RETURN
+    };
+    // 与 koopa_raw_binary_op_t 的顺序一致
+    enum OP { NE, EQ, GT, LT, GE, LE, ADD, SUB, MUL, DIV, MOD, AND, OR, XOR, SHL, SHR, SAR };
+
+    TAG tag;
+    IRType *ty;
+    std::string name;           // 具名变量的名字, 如 @x_0；临时变量为空，打印时再编号
+    /**
+     * 操作数:
+     * LOAD: src; STORE: value, dest; GET_PTR/GET_ELEM_PTR: src, index; BINARY: lhs, rhs
+     * BRANCH: cond, 真分支的参数..., 假分支的参数...; JUMP: 目标块的参数...
+     * CALL: 实参...; RETURN: [返回值]; GLOBAL_ALLOC: init; AGGREGATE: 各元素
+    */
+    std::vector<Value *> ops;
+    std::vector<Value *> users; // 以该value为操作数的指令，可能重复。常量不记录
+    // ops[i]在ops[i]->users中的下标(常量为-1) / users[j]以该value为第几个操作数，用来O(1)删除use
+    std::vector<int> use_pos;
+    std::vector<int> user_slot;
+    BasicBlock *bb;             // 指令所在的基本块, BLOCK_ARG 所属的基本块
+    int value;                  // INTEGER 的值, FUNC_ARG/BLOCK_ARG 的下标, GLOBAL_ALLOC 非0表示只读
+    OP op;                      // BINARY 的运算符
+    Function *callee;           // CALL 调用的函数
+    BasicBlock *target[2];      // JUMP: target[0]; BRANCH: target[0]为真, target[1]为假
+    int n_true_args;            // BRANCH 中真分支参数的个数
+
+    Value(TAG _t, IRType *_ty);
+
+    bool isConst() const { return tag == INTEGER || tag == ZERO_INIT || tag == UNDEF || tag == AGGREGATE; }
+    bool isTerminator() const { return tag == BRANCH || tag == JUMP || tag == RETURN; }
+    bool isInt(int v) const { return tag == INTEGER && value == v; }
+
+    void addOperand(Value *v);
+    void setOperand(int i, Value *v);
+    // 从所有操作数的users中去掉自己，并清空ops
+    void dropOperands();
+    void replaceAllUsesWith(Value *v);
+private:
+    void linkUse(int i);
+    void unlinkUse(int i);
+    void relinkUses(int i);
+public:
+
+    // 跳转到第k个目标时传递的参数区间 [begin, end)
+    int argBegin(int k) const;
+    int argEnd(int k) const;
+    // 给第k个目标追加一个参数 / 删除第k个目标的第i个参数
+    void addArg(int k, Value *v);
+    void removeArg(int k, int i);
+    // 跳转到第k个目标时传递的参数
+    std::vector<Value *> getArgs(int k) const;
+};
+
+// 对两个整数做二元运算，结果与 RV32IM 上执行的结果一致，例如除以0得-1
+int foldBinary(Value::OP op, int a, int b);
+
+// 复制指令时的对应关系，vmap中没有的value(常量、全局变量、复制范围之外的值)对应自身
+Value *mapValue(const std::unordered_map<Value *, Value *> &vmap, Value *v);
+
+class BasicBlock{
+public:
+    std::string name;               // 如 %entry, %then_0
+    std::vector<Value *> params;    // 基本块参数
+    std::list<Value *> insts;
+    Function *func;
+    std::vector<BasicBlock *> preds;    // 前驱，由 Function::buildCFG 计算
+
+    BasicBlock(const std::string &_name, Function *_func): name(_name), func(_func){}
+    Value *getTerminator() const;
+    std::vector<BasicBlock *> getSuccs() const;
+};
+
+class Function{
+private:
+    // 函数体中的指令和基本块，随函数体一起释放
+    Arena<Value, 64> values;
+    Arena<BasicBlock, 16> blocks;
+public:
+    std::string name;               // 如 @main
+    IRType *ret_ty;
+    std::vector<Value *> params;    // 属于Program，释放函数体后仍然保留
+    std::vector<BasicBlock *> bbs;  // bbs[0] 为 entry
+    Program *program;
+    bool is_lib;                    // 库函数，只通过指针参数访问内存
+
+    Function(const std::string &_name, IRType *_ret, Program *_program): name(_name), ret_ty(_ret), program(_program), is_lib(false){}
+    bool isDecl() const { return bbs.empty(); }
+    Value *newValue(Value::TAG tag, IRType *ty);
+    BasicBlock *newBasicBlock(const std::string &name);
+    // 在本函数中复制一条指令，操作数按vmap换成对应的值，跳转目标不变，还不属于任何基本块
+    Value *cloneValue(const Value *v, const std::unordered_map<Value *, Value *> &vmap);
+    // 释放函数体，之后只剩下函数签名
+    void releaseBody();
+    // 重新计算各基本块的前驱
+    void buildCFG();
+    // 逆后序，只包含从entry可达的基本块
+    std::vector<BasicBlock *> getRPO() const;
+    // 删除从entry不可达的基本块，返回删除的个数
+    int removeUnreachable();
+    // 把只有一个前驱、且前驱无条件跳转过来的基本块合并到前驱中，返回合并的个数。之后preds是最新的
+    int mergeBlocks();
+};
+
+class Program{
+private:
+    Arena<Value> values;        // 常量、全局变量、函数参数
+    Arena<Function> functions;
+    std::unordered_map<int, Value *> integers;
+    std::unordered_map<IRType *, Value *> undefs;
+    std::unordered_map<IRType *, Value *> zero_inits;
+public:
+    std::vector<Value *> globals;
+    std::vector<Function *> funcs;
+
+    Value *newValue(Value::TAG tag, IRType *ty);
+    Function *newFunction(const std::string &name, IRType *ret);
+
+    Value *getInt(int i);
+    Value *getZeroInit(IRType *ty);
+    Value *getUndef(IRType *ty);
+    Value *getAggregate(IRType *ty, const std::vector<Value *> &elems);
+
+    // 打印为 Koopa IR 文本，只在 -koopa 模式下需要
+    void dump(KoopaString &ks) const;
+    static void dumpGlobal(KoopaString &ks, const Value *g);
+    static void dumpFunction(KoopaString &ks, const Function *f);
+};
+
+// 在当前基本块的末尾插入指令
+class IRBuilder{
+private:
+    BasicBlock *cur_bb;
+public:
+    Program *program;
+    Function *func;
+
+    IRBuilder();
+    Value *getInt(int i){ return program->getInt(i); }
+
+    Function *createFunction(const std::string &name, IRType *ret, const std::vector<IRType *> &param_tys,
+        const std::vector<std::string> &param_names = std::vector<std::string>());
+    // read_only: 常量数组，程序不会写入
+    Value *createGlobalAlloc(const std::string &name, IRType *ty, Value *init, bool read_only = false);
+    // 创建基本块，此时还不属于函数的基本块列表
+    BasicBlock *createBlock(const std::string &name);
+    // 把基本块加到当前函数末尾，并在其中插入之后的指令
+    void appendBlock(BasicBlock *bb);
+    void setInsertPoint(BasicBlock *bb){ cur_bb = bb; }
+    BasicBlock *getInsertBlock() const { return cur_bb; }
+
+    Value *createAlloc(const std::string &name, IRType *ty);
+    Value *createLoad(Value *src);
+    Value *createStore(Value *v, Value *dest);
+    Value *createGetElemPtr(Value *src, Value *index);
+    Value *createGetPtr(Value *src, Value *index);
+    Value *createBinary(Value::OP op, Value *lhs, Value *rhs);
+    Value *createBranch(Value *cond, BasicBlock *t, BasicBlock *f);
+    Value *createJump(BasicBlock *target);
+    Value *createCall(Function *callee, const std::vector<Value *> &args);
+    Value *createReturn(Value *v = nullptr);
+};
@@ -1,15 +1,9 @@
 #include "Symbol.h"
 #include <iostream>
+#include <map>
+#include <tuple>
 using namespace std;
 
-void NameManager::reset(){
-    cnt = 0;
-}
-
-std::string NameManager::getTmpName(){
-    return "%" + std::to_string(cnt++);
-}
-
 std::string NameManager::getName(const std::string &s){
     auto i = no.find(s);
     if(i == no.end()){
@@ -27,189 +21,96 @@ std::string NameManager::getLabelName(const std::string &s){
     return "%" + s + "_"  + std::to_string(i->second++);
 }
 
-SysYType::SysYType():ty(SYSY_INT), value(-1), next(nullptr){}
-
-SysYType::SysYType(TYPE _t):ty(_t), value(-1), next(nullptr){}
-
-SysYType::SysYType(TYPE _t, int _v): ty(_t), value(_v), next(nullptr){}
-
-SysYType::SysYType(TYPE _t, const std::vector<int> &len):ty(_t), value(-1), next(nullptr){
-    buildFromArrayType(len, _t == SYSY_ARRAY_CONST);
+int IdentTable::intern(std::string_view s){
+    auto it = ids.find(s);
+    if(it != ids.end())
+        return it->second;
+    int id = strs.size();
+    strs.emplace_back(s);
+    ids.emplace(strs.back(), id);
+    return id;
 }
 
-SysYType::~SysYType() { 
-    auto p = next;
-    if(p != nullptr){
-        auto prev = p;
-        p = p->next;
-        delete prev;
-    }
+SysYType::SysYType(TYPE _t, int _v, SysYType *_next): ty(_t), value(_v), next(_next){}
+
+SysYType *SysYType::get(TYPE _t){
+    static unordered_map<int, unique_ptr<SysYType>> pool;
+    auto &p = pool[_t];
+    if(!p) p.reset(new SysYType(_t));
+    return p.get();
 }
 
-void SysYType::buildFromArrayType(const std::vector<int> &len, bool is_const){
+SysYType *SysYType::getArray(const std::vector<int> &len, bool is_const){
+    static map<tuple<int, int, SysYType *>, unique_ptr<SysYType>> pool;
     TYPE t = is_const ? SYSY_ARRAY_CONST : SYSY_ARRAY;
-    SysYType *p = this;
-    for(int i : len){
-        p->ty = t;
-        p->value = i;
-        p->next = new SysYType();
-        p = p->next;
+    SysYType *ty = get(is_const ? SYSY_INT_CONST : SYSY_INT);
+    for(int i = len.size() - 1; i >= 0; --i){
+        auto &p = pool[make_tuple(t, len[i], ty)];
+        if(!p) p.reset(new SysYType(t, len[i], ty));
+        ty = p.get();
     }
-    p->next = new SysYType();
-    p = p->next;
-    p->ty = is_const ? SYSY_INT_CONST : SYSY_INT;
+    return ty;
 }
 
-void SysYType::getArrayType(std::vector<int> &len){
+void SysYType::getArrayType(std::vector<int> &len) const{
     len.clear();
-    SysYType *p = this;
+    const SysYType *p = this;
     while(p->next != nullptr && (p->ty == SYSY_ARRAY_CONST || p->ty == SYSY_ARRAY)){
-        len.push_back(value);
+        len.push_back(p->value);
         p = p->next;
     }
     return;
 }
 
-Symbol::Symbol(const std::string &_ident, const std::string &_name, SysYType *_t): ident(_ident), name(_name), ty(_t){
+Symbol::Symbol(int _ident, const std::string &_name, SysYType *_t, int _value): ident(_ident), name(_name), ty(_t),
+    value(_value), addr(nullptr), func(nullptr), shadowed(nullptr){
 }
 
-Symbol::~Symbol(){
-    if(ty) delete ty;
-}
-
-SymbolTable::~SymbolTable(){
-    for(auto &p : symbol_tb){
-        delete p.second;
-    }
-}
-
-void SymbolTable::insert(Symbol *symbol){
-    symbol_tb.insert({symbol->ident, symbol});
-}
-
-void SymbolTable::insert(const std::string &ident, const std::string &name, SysYType::TYPE _type, int value){
-    SysYType *ty = new SysYType(_type, value);
-    Symbol *sym = new Symbol(ident, name, ty);
-    insert(sym);
-}
-
-void SymbolTable::insertINT(const std::string &ident, const std::string &name){
-    insert(ident, name, SysYType::SYSY_INT, UNKNOWN);
-}
-
-void SymbolTable::insertINTCONST(const std::string &ident, const std::string &name, int value){
-    insert(ident, name, SysYType::SYSY_INT_CONST, value);
-}
-
-void SymbolTable::insertFUNC(const std::string &ident, const std::string &name, SysYType::TYPE _t){
-    insert(ident, name, _t, UNKNOWN);
-}
-
-void SymbolTable::insertArray(const std::string &ident, const std::string &name, const std::vector<int> &len, SysYType::TYPE _t){
-    SysYType *ty = new SysYType(_t, len);
-    Symbol *sym = new Symbol(ident, name, ty);
-    insert(sym);
-}
-
-bool SymbolTable::exists(const std::string &ident){
-    return symbol_tb.find(ident) != symbol_tb.end();
-}
-
-Symbol *SymbolTable::Search(const std::string &ident){
-    return symbol_tb.find(ident)->second;
-}
-
-int SymbolTable::getValue(const std::string &ident){
-    return symbol_tb.find(ident)->second->ty->value;
-}
-
-SysYType *SymbolTable::getType(const std::string &ident){
-    return symbol_tb.find(ident)->second->ty;
-}
-
-std::string SymbolTable::getName(const std::string &ident){
-    return symbol_tb.find(ident)->second->name;
-}
-
-
 void SymbolTableStack::alloc(){
-    sym_tb_st.emplace_back(new SymbolTable());
+    scopes.push_back(undo.size());
 }
 
 void SymbolTableStack::quit(){
-    sym_tb_st.pop_back();
-}
-
-void SymbolTableStack::resetNameManager(){
-    nm.reset();
-}
-
-void SymbolTableStack::insert(Symbol *symbol){
-    sym_tb_st.back()->insert(symbol);
-}
-
-void SymbolTableStack::insert(const std::string &ident, SysYType::TYPE _type, int value){
-    string name = nm.getName(ident);
-    sym_tb_st.back()->insert(ident, name, _type, value);
-}
-
-void SymbolTableStack::insertINT(const std::string &ident){
-    string name = nm.getName(ident);
-    sym_tb_st.back()->insertINT(ident, name);
-}
-
-void SymbolTableStack::insertINTCONST(const std::string &ident, int value){
-    string name = nm.getName(ident);
-    sym_tb_st.back()->insertINTCONST(ident, name, value);
-}
-
-void SymbolTableStack::insertFUNC(const std::string &ident, SysYType::TYPE _t){
-    string name = "@" + ident;
-    sym_tb_st.back()->insertFUNC(ident, name, _t);
+    size_t n = scopes.back();
+    scopes.pop_back();
+    while(undo.size() > n){
+        int ident = undo.back();
+        binding[ident] = binding[ident]->shadowed;
+        undo.pop_back();
+    }
 }
 
-void SymbolTableStack::insertArray(const std::string &ident, const std::vector<int> &len, SysYType::TYPE _t){
-    string name = nm.getName(ident);
-    sym_tb_st.back()->insertArray(ident, name, len, _t);
+void SymbolTableStack::releaseLocals(){
+    local_symbols.clear();
 }
 
-bool SymbolTableStack::exists(const std::string &ident){
-    for(int i = (int)sym_tb_st.size() - 1; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            return true;
-    }
-    return false;
+Symbol *SymbolTableStack::insert(int ident, const std::string &name, SysYType *ty, int value){
+    if((size_t)ident >= binding.size())
+        binding.resize(idents.size(), nullptr);
+    // 只有全局作用域时插入的是全局符号
+    Arena<Symbol, 64> &pool = scopes.size() == 1 ? global_symbols : local_symbols;
+    Symbol *sym = pool.create(ident, name, ty, value);
+    sym->shadowed = binding[ident];
+    binding[ident] = sym;
+    undo.push_back(ident);
+    return sym;
 }
 
-int SymbolTableStack::getValue(const std::string &ident){
-    int i = (int)sym_tb_st.size() - 1;
-    for(; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            break;
-    }
-    return sym_tb_st[i]->getValue(ident);
+Symbol *SymbolTableStack::insertINT(int ident){
+    return insert(ident, nm.getName(idents.str(ident)), SysYType::get(SysYType::SYSY_INT));
 }
 
-SysYType *SymbolTableStack::getType(const std::string &ident){
-    int i = (int)sym_tb_st.size() - 1;
-    for(; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            break;
-    }
-    return sym_tb_st[i]->getType(ident);
+Symbol *SymbolTableStack::insertINTCONST(int ident, int value){
+    return insert(ident, nm.getName(idents.str(ident)), SysYType::get(SysYType::SYSY_INT_CONST), value);
 }
 
-std::string SymbolTableStack::getName(const std::string &ident){
-    int i = (int)sym_tb_st.size() - 1;
-    for(; i >= 0; --i){
-        if(sym_tb_st[i]->exists(ident))
-            break;
-    }
-    return sym_tb_st[i]->getName(ident);
+Symbol *SymbolTableStack::insertFUNC(int ident, SysYType::TYPE _t){
+    return insert(ident, "@" + idents.str(ident), SysYType::get(_t));
 }
 
-std::string SymbolTableStack::getTmpName(){
-    return nm.getTmpName();
+Symbol *SymbolTableStack::insertArray(int ident, const std::vector<int> &len, SysYType::TYPE _t){
+    SysYType *ty = SysYType::getArray(len, _t == SysYType::SYSY_ARRAY_CONST);
+    return insert(ident, nm.getName(idents.str(ident)), ty);
 }
 
 std::string SymbolTableStack::getLabelName(const std::string &label_ident){
@@ -217,4 +118,4 @@ std::string SymbolTableStack::getLabelName(const std::string &label_ident){
 }
 std::string SymbolTableStack::getVarName(const std::string& var){
     return nm.getName(var);
-}
\ No newline at end of file
+}
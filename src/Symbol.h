@@ -1,23 +1,37 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
+#include "IR.h"
 
 class NameManager{
 private:
-    int cnt;
     std::unordered_map<std::string, int> no;
 public:
-    NameManager():cnt(0){}
-    void reset();
-    std::string getTmpName();
     std::string getName(const std::string &s);
     std::string getLabelName(const std::string &s);
 };
 
+/**
+ * 标识符驻留。词法分析时每个标识符换成一个编号，相同的标识符编号相同，
+ * 之后符号表的查找只用编号，不再对字符串求哈希。字符串保存到编译结束。
+*/
+class IdentTable{
+private:
+    std::unordered_map<std::string_view, int> ids;
+    std::deque<std::string> strs;   // 编号 -> 标识符，deque保证扩容时字符串不移动
+public:
+    int intern(std::string_view s);
+    const std::string &str(int id) const { return strs[id]; }
+    size_t size() const { return strs.size(); }
+};
 
+extern IdentTable idents;
+
+// 类型是驻留的，相同的类型只有一个对象，可以直接比较指针
 class SysYType{
     public:
         enum TYPE{
@@ -26,79 +40,59 @@ class SysYType{
         };
 
         TYPE ty;
-        int value;
-        SysYType *next;
-
-        SysYType();
-        SysYType(TYPE _t);
-        SysYType(TYPE _t, int _v);
-        SysYType(TYPE _t, const std::vector<int> &len);
-
-        ~SysYType();
-        void buildFromArrayType(const std::vector<int> &len, bool is_const);
-        void getArrayType(std::vector<int> &len);
+        int value;          // 数组这一维的长度，-1表示指针(函数参数的第一维)
+        SysYType *next;     // 数组元素的类型
+
+        SysYType(TYPE _t, int _v = -1, SysYType *_next = nullptr);
+        // int, const int 和函数
+        static SysYType *get(TYPE _t);
+        // 多维数组，如 len = {-1, 3} 得到参数 a[][3] 的类型
+        static SysYType *getArray(const std::vector<int> &len, bool is_const);
+        void getArrayType(std::vector<int> &len) const;
 };
 
 class Symbol{
 public:
-    std::string ident;   // SysY标识符，诸如x,y
+    int ident;           // SysY标识符的编号，诸如x,y
     std::string name;    // KoopaIR中的具名变量，诸如@x_1, @y_1, ..., @n_2
     SysYType *ty;
-    Symbol(const std::string &_ident, const std::string &_name, SysYType *_t);
-    ~Symbol();
-};
-
-class SymbolTable{
-public:
-    const int UNKNOWN = -1;
-    std::unordered_map<std::string, Symbol *> symbol_tb;  // ident -> Symbol *
-    SymbolTable() = default;
-    ~SymbolTable();
-    void insert(Symbol *symbol);
-
-    void insert(const std::string &ident, const std::string &name, SysYType::TYPE _type, int value);
-
-    void insertINT(const std::string &ident, const std::string &name);
-
-    void insertINTCONST(const std::string &ident, const std::string &name, int value);
-
-    void insertFUNC(const std::string &ident, const std::string &name, SysYType::TYPE _t);
-
-    void insertArray(const std::string &ident, const std::string &name, const std::vector<int> &len, SysYType::TYPE _t);
-
-    bool exists(const std::string &ident);
-
-    Symbol *Search(const std::string &ident);
-
-    int getValue(const std::string &ident);
-
-    SysYType *getType(const std::string &ident);
-
-    std::string getName(const std::string &ident);
-
+    int value;           // 常量的值
+    std::vector<std::pair<int, int>> inits;  // 常量数组的非零元素(展平后的下标, 值)，按下标递增
+    Value *addr;         // 变量在IR中的地址，即对应的alloc或global alloc
+    Function *func;      // 函数在IR中的定义
+    Symbol *shadowed;    // 被它遮盖的外层作用域中的同名符号
+    Symbol(int _ident, const std::string &_name, SysYType *_t, int _value = -1);
 };
 
+/**
+ * 作用域嵌套的符号表。只有一张按标识符编号下标的表，存放当前可见的符号，
+ * 被遮盖的外层符号挂在shadowed上。每个作用域插入的标识符依次记在undo中，
+ * 退出作用域时倒序恢复。查找只需访问一次数组。
+ * 语义分析把Symbol *记在AST上，生成IR时还要用，所以退出作用域时不释放符号：
+ * 全局符号一直保留，局部符号在一个函数的IR生成完后由releaseLocals统一释放。
+*/
 class SymbolTableStack{
 private:
-    std::deque<std::unique_ptr<SymbolTable>> sym_tb_st;
+    std::vector<Symbol *> binding;  // 标识符编号 -> 当前可见的符号
+    std::vector<int> undo;          // 各作用域中插入的标识符
+    std::vector<size_t> scopes;     // 每个作用域开始时undo的长度
     NameManager nm;
+    Arena<Symbol, 64> global_symbols;
+    Arena<Symbol, 64> local_symbols;
+    Symbol *insert(int ident, const std::string &name, SysYType *ty, int value = -1);
 public:
-    const int UNKNOWN = -1;
     void alloc();
     void quit();
-    void resetNameManager();
-    void insert(Symbol *symbol);
-    void insert(const std::string &ident, SysYType::TYPE _type, int value);
-    void insertINT(const std::string &ident);
-    void insertINTCONST(const std::string &ident, int value);
-    void insertFUNC(const std::string &ident, SysYType::TYPE _t);
-    void insertArray(const std::string &ident, const std::vector<int> &len, SysYType::TYPE _t);
-    bool exists(const std::string &ident);
-    int getValue(const std::string &ident);
-    SysYType *getType(const std::string &ident);
-    std::string getName(const std::string &ident);
+    void releaseLocals();
+    Symbol *insertINT(int ident);
+    Symbol *insertINTCONST(int ident, int value);
+    Symbol *insertFUNC(int ident, SysYType::TYPE _t);
+    Symbol *insertArray(int ident, const std::vector<int> &len, SysYType::TYPE _t);
+    // 当前可见的符号，不存在时返回nullptr
+    Symbol *lookup(int ident) const {
+        return (size_t)ident < binding.size() ? binding[ident] : nullptr;
+    }
 
-    std::string getTmpName();   // inherit from name manager
     std::string getLabelName(const std::string &label_ident); // inherit from name manager
     std::string getVarName(const std::string& var);   // aux var name, such as @short_circuit_res,shouldn't insert it into Symbol table.
-};
\ No newline at end of file
+};
@@ -0,0 +1,91 @@
+#include "pass.h"
+using namespace std;
+
+// Cooper, Harvey, Kennedy. A Simple, Fast Dominance Algorithm.
+void DominatorTree::build(Function *func){
+    rpo = func->getRPO();
+    int n = rpo.size();
+    index.clear();
+    for(int i = 0; i < n; ++i)
+        index[rpo[i]] = i;
+
+    idom.assign(n, -1);
+    if(n == 0) return;
+    idom[0] = 0;
+    auto intersect = [&](int a, int b){
+        while(a != b){
+            while(a > b) a = idom[a];
+            while(b > a) b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(int i = 1; i < n; ++i){
+            int new_idom = -1;
+            for(auto p : rpo[i]->preds){
+                auto it = index.find(p);
+                if(it == index.end() || idom[it->second] < 0)
+                    continue;
+                new_idom = new_idom < 0 ? it->second : intersect(it->second, new_idom);
+            }
+            if(new_idom != idom[i]){
+                idom[i] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    children.assign(n, vector<int>());
+    for(int i = 1; i < n; ++i)
+        children[idom[i]].push_back(i);
+
+    // 支配树上的DFS时间戳，用于O(1)判断支配关系
+    pre.assign(n, 0);
+    post.assign(n, 0);
+    int clock = 0;
+    vector<pair<int, size_t>> stk;
+    stk.emplace_back(0, 0);
+    pre[0] = clock++;
+    while(!stk.empty()){
+        auto &top = stk.back();
+        if(top.second < children[top.first].size()){
+            int c = children[top.first][top.second++];
+            pre[c] = clock++;
+            stk.emplace_back(c, 0);
+        } else {
+            post[top.first] = clock++;
+            stk.pop_back();
+        }
+    }
+}
+
+void DominatorTree::buildFrontier(){
+    int n = rpo.size();
+    frontier.assign(n, vector<int>());
+    for(int i = 0; i < n; ++i){
+        if(rpo[i]->preds.size() < 2) continue;
+        for(auto p : rpo[i]->preds){
+            auto it = index.find(p);
+            if(it == index.end()) continue;
+            int runner = it->second;
+            while(runner != idom[i]){
+                auto &df = frontier[runner];
+                if(df.empty() || df.back() != i)
+                    df.push_back(i);
+                if(runner == 0) break;
+                runner = idom[runner];
+            }
+        }
+    }
+}
+
+bool DominatorTree::dominates(int a, int b) const{
+    return pre[a] <= pre[b] && post[b] <= post[a];
+}
+
+int DominatorTree::getIndex(BasicBlock *bb) const{
+    auto it = index.find(bb);
+    return it == index.end() ? -1 : it->second;
+}
@@ -0,0 +1,180 @@
+#include "pass.h"
+#include <cassert>
+#include <functional>
+using namespace std;
+
+/**
+ * 全局值编号。沿支配树遍历，在支配当前基本块的块中算过的同一个表达式（运算符和操作数都相同的
+ * 二元运算、getelemptr/getptr）直接复用，可交换的运算先把操作数排序。
+ * load另外处理：记录每个地址当前已知的值（load的结果或最后一次store的值），
+ * 遇到可能写同一个位置的store或者调用时作废。只在基本块内、以及沿只有一个前驱的后继传递，
+ * 这样已知的值不会经过其它路径上的store。
+*/
+
+static const size_t MAX_KNOWN_LOADS = 256;     // 已知值太多时全部丢弃，避免每次store都扫描很多项
+
+namespace {
+struct ExprKey{
+    Value::TAG tag;
+    Value::OP op;
+    Value *a, *b;
+    bool operator==(const ExprKey &o) const { return tag == o.tag && op == o.op && a == o.a && b == o.b; }
+};
+
+struct ExprHash{
+    size_t operator()(const ExprKey &k) const{
+        size_t h = hash<Value *>()(k.a) * 31 + hash<Value *>()(k.b);
+        return h * 31 + k.tag * 17 + k.op;
+    }
+};
+
+// 指针所指的对象和相对它的偏移(字节)，偏移不是常量时known为false
+struct Location{
+    Value *root;
+    int offset;
+    bool known;
+};
+}
+
+static bool isCommutative(Value::OP op){
+    return op == Value::ADD || op == Value::MUL || op == Value::AND || op == Value::OR ||
+           op == Value::XOR || op == Value::EQ || op == Value::NE;
+}
+
+static bool isPure(Value *v){
+    return v->tag == Value::BINARY || v->tag == Value::GET_PTR || v->tag == Value::GET_ELEM_PTR;
+}
+
+static ExprKey keyOf(Value *v){
+    ExprKey k{v->tag, v->tag == Value::BINARY ? v->op : Value::ADD, v->ops[0], v->ops[1]};
+    if(v->tag == Value::BINARY && isCommutative(v->op) && k.b < k.a)
+        swap(k.a, k.b);
+    return k;
+}
+
+static Location locate(Value *p){
+    Location loc{p, 0, true};
+    while(loc.root->tag == Value::GET_PTR || loc.root->tag == Value::GET_ELEM_PTR){
+        Value *idx = loc.root->ops[1];
+        if(idx->tag == Value::INTEGER)
+            loc.offset += idx->value * loc.root->ty->base->getSize();
+        else
+            loc.known = false;
+        loc.root = loc.root->ops[0];
+    }
+    return loc;
+}
+
+/**
+ * 两个地址是否可能指向同一个位置。不同的局部数组、全局变量互不重叠；
+ * 指针参数只可能指向全局变量或调用者的数组，不会指向本函数的局部数组。
+*/
+bool mayAlias(Value *p, Value *q){
+    if(p == q) return true;
+    Location a = locate(p), b = locate(q);
+    if(a.root == b.root)
+        return !a.known || !b.known || a.offset == b.offset;
+    auto isObject = [](Value *r){ return r->tag == Value::ALLOC || r->tag == Value::GLOBAL_ALLOC; };
+    if(isObject(a.root) && isObject(b.root))
+        return false;
+    if(a.root->tag == Value::ALLOC && b.root->tag == Value::FUNC_ARG)
+        return false;
+    if(b.root->tag == Value::ALLOC && a.root->tag == Value::FUNC_ARG)
+        return false;
+    return true;
+}
+
+// 调用是否可能写内存。库函数只通过指针参数访问内存
+bool mayWrite(Value *call){
+    if(!call->callee->is_lib) return true;
+    for(auto a : call->ops){
+        if(a->ty->tag == IRType::POINTER)
+            return true;
+    }
+    return false;
+}
+
+int gvn(Function *func){
+    func->buildCFG();
+    DominatorTree dt;
+    dt.build(func);
+    int removed = 0;
+
+    unordered_map<ExprKey, Value *, ExprHash> exprs;
+    vector<ExprKey> undo;
+    // (基本块, 下一个要访问的孩子, 进入时undo的长度, 基本块末尾各地址已知的值)
+    struct Frame{
+        int b;
+        size_t child;
+        size_t undo_size;
+        unordered_map<Value *, Value *> known;
+    };
+    vector<Frame> stk;
+    stk.push_back(Frame{0, 0, 0, {}});
+    bool enter = true;
+    while(!stk.empty()){
+        Frame &fr = stk.back();
+        if(enter){
+            BasicBlock *bb = dt.rpo[fr.b];
+            auto &known = fr.known;
+            for(auto it = bb->insts.begin(); it != bb->insts.end(); ){
+                Value *v = *it;
+                Value *same = nullptr;
+                if(isPure(v)){
+                    ExprKey k = keyOf(v);
+                    auto e = exprs.find(k);
+                    if(e != exprs.end()){
+                        same = e->second;
+                    } else {
+                        exprs.emplace(k, v);
+                        undo.push_back(k);
+                    }
+                } else if(v->tag == Value::LOAD){
+                    auto e = known.find(v->ops[0]);
+                    if(e != known.end())
+                        same = e->second;
+                    else
+                        known[v->ops[0]] = v;
+                } else if(v->tag == Value::STORE){
+                    Value *dest = v->ops[1];
+                    for(auto e = known.begin(); e != known.end(); ){
+                        if(mayAlias(e->first, dest))
+                            e = known.erase(e);
+                        else
+                            ++e;
+                    }
+                    known[dest] = v->ops[0];
+                } else if(v->tag == Value::CALL && mayWrite(v)){
+                    known.clear();
+                }
+                if(known.size() > MAX_KNOWN_LOADS)
+                    known.clear();
+                if(same != nullptr){
+                    v->replaceAllUsesWith(same);
+                    v->dropOperands();
+                    it = bb->insts.erase(it);
+                    ++removed;
+                } else {
+                    ++it;
+                }
+            }
+            enter = false;
+        }
+        if(fr.child < dt.children[fr.b].size()){
+            int c = dt.children[fr.b][fr.child++];
+            // 只有一个前驱的后继继承已知的值，它的前驱就是支配树上的父亲
+            Frame child{c, 0, undo.size(), {}};
+            if(dt.rpo[c]->preds.size() == 1)
+                child.known = fr.known;
+            stk.push_back(move(child));
+            enter = true;
+        } else {
+            while(undo.size() > fr.undo_size){
+                exprs.erase(undo.back());
+                undo.pop_back();
+            }
+            stk.pop_back();
+        }
+    }
+    return removed;
+}
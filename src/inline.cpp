@@ -0,0 +1,195 @@
+#include "pass.h"
+#include <algorithm>
+#include <unordered_set>
+using namespace std;
+
+/**
+ * 函数内联。函数按定义的顺序逐个生成、优化并输出，SysY没有函数的前置声明，只能调用在它之前定义的函数和它自己，
+ * 所以调用图中的环只有直接递归，而且处理调用者时被调用者已经优化完。
+ * 足够小、不递归、没有局部数组的函数优化后保留函数体，推迟到程序结束再输出；之后的函数中调用它的地方，
+ * 按被调用者的大小、调用点所在循环的深度、调用者中调用它的次数决定是否把函数体复制过来，调用者的增长也有上限。
+ * 程序结束时仍然被调用的保留函数才输出，其余的直接删去。
+*/
+
+static const int MAX_INLINE_SIZE = 64;      // 保留函数体的函数最多的指令数
+static const int ALWAYS_INLINE_SIZE = 12;   // 不超过它(再加上参数个数)的总是内联，不比调用本身多几条指令
+static const int INLINE_SIZE_STEP = 16;     // 调用点每深一层循环，或者只被调用一次，允许多内联的指令数
+static const int MIN_GROWTH_BUDGET = 256;   // 调用者因内联增加的指令数上限，调用者更大时以它的大小为上限
+
+static vector<Function *> kept;                 // 保留了函数体的函数，按定义的顺序
+static unordered_map<Function *, int> kept_size;
+static unordered_set<Function *> live;          // 已经输出的函数调用了的保留函数
+static int inline_count = 0;                    // 内联过的调用点个数，用来给复制出的基本块起不重复的名字
+
+/**
+ * 把call换成callee函数体的副本。call之后的指令移到新的基本块cont中，返回值是它的参数；
+ * 原来的基本块跳到副本的entry，副本中的ret改为跳到cont。形参直接换成实参。
+*/
+static void inlineCall(Value *call, Function *callee){
+    BasicBlock *bb = call->bb;
+    Function *func = bb->func;
+    string suffix = "_i" + to_string(inline_count);
+    BasicBlock *cont = func->newBasicBlock(bb->name + "_ret" + to_string(inline_count));
+    ++inline_count;
+    func->bbs.push_back(cont);
+
+    unordered_map<Value *, Value *> vmap;
+    for(size_t i = 0; i < callee->params.size(); ++i)
+        vmap[callee->params[i]] = call->ops[i];
+    if(call->ty->tag != IRType::UNIT){
+        Value *r = func->newValue(Value::BLOCK_ARG, call->ty);
+        r->bb = cont;
+        r->value = 0;
+        cont->params.push_back(r);
+        call->replaceAllUsesWith(r);
+    }
+
+    // 先建出所有基本块，再按rpo复制指令：操作数的定义支配使用，复制时已经有对应的值
+    vector<BasicBlock *> rpo = callee->getRPO();
+    unordered_map<BasicBlock *, BasicBlock *> bmap;
+    for(auto cb : rpo){
+        BasicBlock *nb = func->newBasicBlock(cb->name + suffix);
+        for(auto p : cb->params){
+            Value *q = func->newValue(Value::BLOCK_ARG, p->ty);
+            q->bb = nb;
+            q->value = p->value;
+            nb->params.push_back(q);
+            vmap[p] = q;
+        }
+        bmap[cb] = nb;
+        func->bbs.push_back(nb);
+    }
+    for(auto cb : rpo){
+        BasicBlock *nb = bmap[cb];
+        for(auto v : cb->insts){
+            Value *nv;
+            if(v->tag == Value::RETURN){
+                nv = func->newValue(Value::JUMP, IRType::getUnit());
+                nv->target[0] = cont;
+                if(!cont->params.empty())
+                    nv->addArg(0, mapValue(vmap, v->ops[0]));
+            } else {
+                nv = func->cloneValue(v, vmap);
+                if(v->tag == Value::JUMP || v->tag == Value::BRANCH)
+                    nv->target[0] = bmap[v->target[0]];
+                if(v->tag == Value::BRANCH)
+                    nv->target[1] = bmap[v->target[1]];
+            }
+            nv->bb = nb;
+            nb->insts.push_back(nv);
+            vmap[v] = nv;
+        }
+    }
+
+    auto it = find(bb->insts.begin(), bb->insts.end(), call);
+    for(auto i = next(it); i != bb->insts.end(); ++i)
+        (*i)->bb = cont;
+    cont->insts.splice(cont->insts.end(), bb->insts, next(it), bb->insts.end());
+    bb->insts.erase(it);
+    call->dropOperands();
+    Value *j = func->newValue(Value::JUMP, IRType::getUnit());
+    j->bb = bb;
+    j->target[0] = bmap[callee->bbs[0]];
+    bb->insts.push_back(j);
+}
+
+static bool profitable(int size, int n_args, int depth, int sites){
+    if(size <= ALWAYS_INLINE_SIZE + n_args)
+        return true;
+    int limit = INLINE_SIZE_STEP * min(depth, 3);
+    if(sites == 1)
+        limit += INLINE_SIZE_STEP;
+    return size <= limit;
+}
+
+int inlineCalls(Function *func){
+    if(kept.empty()) return 0;
+    func->buildCFG();
+    DominatorTree dt;
+    dt.build(func);
+    LoopInfo li;
+    li.build(dt);
+
+    // 调用保留函数的地方，循环深的先内联
+    int size = 0;
+    vector<pair<int, Value *>> sites;
+    unordered_map<Function *, int> n_sites;
+    for(size_t b = 0; b < dt.rpo.size(); ++b){
+        for(auto v : dt.rpo[b]->insts){
+            ++size;
+            if(v->tag == Value::CALL && kept_size.count(v->callee)){
+                sites.emplace_back(li.getDepth(b), v);
+                ++n_sites[v->callee];
+            }
+        }
+    }
+    stable_sort(sites.begin(), sites.end(), [](const pair<int, Value *> &a, const pair<int, Value *> &b){
+        return a.first > b.first;
+    });
+    int budget = max(MIN_GROWTH_BUDGET, size), inlined = 0;
+    for(auto &s : sites){
+        Function *callee = s.second->callee;
+        int callee_size = kept_size[callee];
+        if(callee_size > budget || !profitable(callee_size, s.second->ops.size(), s.first, n_sites[callee]))
+            continue;
+        inlineCall(s.second, callee);
+        budget -= callee_size;
+        ++inlined;
+    }
+    if(inlined > 0){
+        func->buildCFG();
+        func->mergeBlocks();
+    }
+    return inlined;
+}
+
+// 函数中调用的保留函数
+static void markCalls(Function *func, vector<Function *> &work){
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(v->tag == Value::CALL && kept_size.count(v->callee) && live.insert(v->callee).second)
+                work.push_back(v->callee);
+        }
+    }
+}
+
+bool keepForInline(Function *func){
+    int size = 0;
+    bool ok = func->name != "@main";
+    for(auto bb : func->getRPO()){
+        for(auto v : bb->insts){
+            ++size;
+            // 局部数组会加大调用者的栈帧，递归调用者中可能用光栈
+            if(v->tag == Value::ALLOC || (v->tag == Value::CALL && v->callee == func))
+                ok = false;
+        }
+    }
+    if(ok && size <= MAX_INLINE_SIZE){
+        kept.push_back(func);
+        kept_size[func] = size;
+        return true;
+    }
+    vector<Function *> work;
+    markCalls(func, work);
+    return false;
+}
+
+vector<Function *> takeKeptFunctions(){
+    vector<Function *> work(live.begin(), live.end());
+    while(!work.empty()){
+        Function *f = work.back();
+        work.pop_back();
+        markCalls(f, work);
+    }
+    vector<Function *> res;
+    for(auto f : kept){
+        if(live.count(f))
+            res.push_back(f);
+        else
+            f->releaseBody();
+    }
+    kept.clear();
+    kept_size.clear();
+    live.clear();
+    return res;
+}
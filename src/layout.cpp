@@ -0,0 +1,107 @@
+#include "pass.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+/**
+ * 基本块布局。先静态估计每条边的执行频率，再按频率从高到低把边的两端连成链(Pettis-Hansen)，
+ * 同一条链上相邻的块之间落下去即可，不需要跳转。
+ * 频率的估计：循环每深一层执行次数乘10；条件分支的两个后继中循环深度大的一边概率取0.9，
+ * 即留在循环中、进入循环的一边更可能，离开循环的一边不太可能；深度相同时各取一半。
+*/
+
+vector<BasicBlock *> layoutBlocks(Function *func){
+    vector<BasicBlock *> &bbs = func->bbs;
+    int n = bbs.size();
+    if(n <= 2) return bbs;
+    func->buildCFG();
+    DominatorTree dt;
+    dt.build(func);
+    LoopInfo li;
+    li.build(dt);
+
+    unordered_map<BasicBlock *, int> id;
+    for(int i = 0; i < n; ++i)
+        id[bbs[i]] = i;
+    vector<int> depth(n, 0);
+    for(int i = 0; i < n; ++i){
+        int r = dt.getIndex(bbs[i]);
+        if(r >= 0) depth[i] = li.getDepth(r);
+    }
+
+    // 1. 估计每条边的频率
+    struct Edge{ int from, to; double weight; };
+    vector<Edge> edges;
+    for(int u = 0; u < n; ++u){
+        double freq = pow(10.0, min(depth[u], 8));
+        auto succs = bbs[u]->getSuccs();
+        if(succs.size() == 1){
+            edges.push_back(Edge{u, id[succs[0]], freq});
+        } else if(succs.size() == 2){
+            int a = id[succs[0]], b = id[succs[1]];
+            double pa = depth[a] > depth[b] ? 0.9 : depth[a] < depth[b] ? 0.1 : 0.5;
+            edges.push_back(Edge{u, a, freq * pa});
+            edges.push_back(Edge{u, b, freq * (1 - pa)});
+        }
+    }
+    stable_sort(edges.begin(), edges.end(), [](const Edge &x, const Edge &y){
+        return x.weight > y.weight;
+    });
+
+    // 2. 把边的两端连成链。from须是链尾，to须是另一条链的链头，entry只能做链头
+    vector<int> next(n, -1), prev(n, -1), root(n);
+    for(int i = 0; i < n; ++i)
+        root[i] = i;
+    auto find = [&](int x){
+        while(root[x] != x){
+            root[x] = root[root[x]];
+            x = root[x];
+        }
+        return x;
+    };
+    for(auto &e : edges){
+        if(e.to == 0 || next[e.from] >= 0 || prev[e.to] >= 0)
+            continue;
+        int a = find(e.from), b = find(e.to);
+        if(a == b) continue;
+        next[e.from] = e.to;
+        prev[e.to] = e.from;
+        root[b] = a;
+    }
+    vector<int> head(n);
+    for(int i = 0; i < n; ++i){
+        if(prev[i] >= 0) continue;
+        for(int b = i; b >= 0; b = next[b])
+            head[b] = i;
+    }
+
+    // 3. 排列各条链。从entry所在的链开始，之后优先放链尾最可能跳到的链，没有时按原来的顺序
+    vector<BasicBlock *> order;
+    vector<bool> placed(n, false);
+    vector<vector<int>> succ_by_weight(n);     // 按边的频率从高到低排列的后继
+    for(auto &e : edges)
+        succ_by_weight[e.from].push_back(e.to);
+    int scan = 0;
+    int cur = 0;
+    while(cur >= 0){
+        int tail = cur;
+        for(int b = cur; b >= 0; b = next[b]){
+            order.push_back(bbs[b]);
+            placed[b] = true;
+            tail = b;
+        }
+        cur = -1;
+        for(int s : succ_by_weight[tail]){
+            if(!placed[head[s]]){
+                cur = head[s];
+                break;
+            }
+        }
+        while(cur < 0 && scan < n){
+            if(!placed[scan])
+                cur = head[scan];
+            ++scan;
+        }
+    }
+    return order;
+}
@@ -0,0 +1,204 @@
+#include "pass.h"
+#include <algorithm>
+#include <cassert>
+using namespace std;
+
+/**
+ * 循环不变量外提。从内层循环到外层循环依次处理，提到内层循环前的指令属于外层循环，
+ * 之后还可以继续往外提。操作数都在循环外定义(或已经提出)的二元运算和getelemptr/getptr
+ * 没有副作用，直接提到循环前；load还要求循环中没有可能写同一位置的store和调用，
+ * 并且每轮都会执行到(所在的基本块支配所有回边和出口)，提前执行不会访问本来不访问的地址。
+ * 提出的指令放在新建的preheader中：循环外跳到头部的边改为跳到preheader，再由它跳到头部。
+*/
+
+static const size_t MAX_LOOP_STORES = 64;  // store太多时不再逐个判断别名，循环中的load都不外提
+
+namespace {
+// 一个循环(包括内层循环)中写内存的指令
+struct LoopMemory{
+    vector<Value *> stores;     // store的地址
+    bool unknown = false;       // 有可能写内存的调用，或store太多
+};
+}
+
+static void addStore(LoopMemory &mem, Value *dest){
+    if(mem.unknown) return;
+    if(mem.stores.size() >= MAX_LOOP_STORES){
+        mem.unknown = true;
+        mem.stores.clear();
+        return;
+    }
+    mem.stores.push_back(dest);
+}
+
+// 新建preheader，循环外跳到header的边改为跳到它
+static BasicBlock *createPreheader(BasicBlock *header, const vector<BasicBlock *> &outside){
+    Function *func = header->func;
+    BasicBlock *ph = func->newBasicBlock(header->name + "_ph");
+    for(auto p : header->params){
+        Value *q = func->newValue(Value::BLOCK_ARG, p->ty);
+        q->bb = ph;
+        q->value = ph->params.size();
+        ph->params.push_back(q);
+    }
+    for(auto p : outside){
+        Value *term = p->getTerminator();
+        int n = term->tag == Value::BRANCH ? 2 : 1;
+        for(int k = 0; k < n; ++k){
+            if(term->target[k] == header)
+                term->target[k] = ph;
+        }
+    }
+    Value *j = func->newValue(Value::JUMP, IRType::getUnit());
+    j->bb = ph;
+    j->target[0] = header;
+    for(auto q : ph->params)
+        j->addArg(0, q);
+    ph->insts.push_back(j);
+    func->bbs.push_back(ph);
+    return ph;
+}
+
+int licm(Function *func){
+    func->buildCFG();
+    DominatorTree dt;
+    dt.build(func);
+    LoopInfo li;
+    li.build(dt);
+    int m = li.header.size();
+    if(m == 0) return 0;
+    int n = dt.rpo.size();
+
+    // 1. 每个循环中写内存的指令，以及离开循环的基本块(有后继在循环外，或者return)
+    vector<LoopMemory> mem(m);
+    vector<vector<int>> exits(m);
+    for(int b = 0; b < n; ++b){
+        int l = li.loop_of[b];
+        if(l < 0) continue;
+        for(auto v : dt.rpo[b]->insts){
+            if(v->tag == Value::STORE)
+                addStore(mem[l], v->ops[1]);
+            else if(v->tag == Value::CALL && mayWrite(v))
+                mem[l].unknown = true;
+        }
+        Value *term = dt.rpo[b]->getTerminator();
+        if(term->tag == Value::RETURN){
+            for(int k = l; k >= 0; k = li.parent[k])
+                exits[k].push_back(b);
+            continue;
+        }
+        for(auto s : dt.rpo[b]->getSuccs()){
+            int t = dt.getIndex(s);
+            for(int k = l; k >= 0 && !li.contains(k, t); k = li.parent[k]){
+                if(exits[k].empty() || exits[k].back() != b)
+                    exits[k].push_back(b);
+            }
+        }
+    }
+    for(int l = 0; l < m; ++l){
+        int p = li.parent[l];
+        if(p < 0) continue;
+        if(mem[l].unknown) mem[p].unknown = true;
+        for(auto d : mem[l].stores)
+            addStore(mem[p], d);
+    }
+
+    // 2. 从内层到外层，找出每个循环中不变的指令，提到preheader中
+    unordered_map<BasicBlock *, int> ph_loop;   // 新建的preheader属于哪个循环
+    auto inLoop = [&](int l, BasicBlock *bb){
+        if(bb == nullptr) return false;
+        int b = dt.getIndex(bb);
+        if(b >= 0) return li.contains(l, b);
+        auto it = ph_loop.find(bb);
+        if(it == ph_loop.end()) return false;
+        for(int k = it->second; k >= 0; k = li.parent[k]){
+            if(k == l) return true;
+        }
+        return false;
+    };
+    vector<vector<int>> blocks(m);      // 属于该循环、不属于内层循环的基本块，rpo顺序
+    for(int b = 0; b < n; ++b){
+        if(li.loop_of[b] >= 0)
+            blocks[li.loop_of[b]].push_back(b);
+    }
+    vector<vector<BasicBlock *>> inner_ph(m);   // 该循环中的内层循环的preheader
+    int hoisted = 0;
+    for(int l = 0; l < m; ++l){
+        int h = li.header[l];
+        vector<int> latches;
+        vector<BasicBlock *> outside;
+        for(auto p : dt.rpo[h]->preds){
+            int b = dt.getIndex(p);
+            if(b >= 0 && li.contains(l, b))
+                latches.push_back(b);
+            else
+                outside.push_back(p);
+        }
+        auto everyIteration = [&](int b){
+            for(int e : exits[l]){
+                if(!dt.dominates(b, e)) return false;
+            }
+            for(int e : latches){
+                if(!dt.dominates(b, e)) return false;
+            }
+            return true;
+        };
+        auto invariant = [&](Value *v){
+            for(auto o : v->ops){
+                if(!o->isConst() && inLoop(l, o->bb))
+                    return false;
+            }
+            return true;
+        };
+        auto canHoistLoad = [&](Value *v, int b){
+            if(mem[l].unknown || !everyIteration(b)) return false;
+            for(auto d : mem[l].stores){
+                if(mayAlias(d, v->ops[0])) return false;
+            }
+            return true;
+        };
+
+        vector<Value *> moved;
+        auto scan = [&](BasicBlock *bb, int b){
+            for(auto it = bb->insts.begin(); it != bb->insts.end(); ){
+                Value *v = *it;
+                bool ok = false;
+                if(v->tag == Value::BINARY || v->tag == Value::GET_PTR || v->tag == Value::GET_ELEM_PTR)
+                    ok = invariant(v);
+                else if(v->tag == Value::LOAD)
+                    ok = invariant(v) && canHoistLoad(v, b);
+                if(ok){
+                    moved.push_back(v);
+                    v->bb = nullptr;    // 之后的指令判断操作数时视为在循环外
+                    it = bb->insts.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        };
+        // 按rpo的顺序扫描，内层循环的preheader不在rpo中，排在它的头部之前
+        vector<pair<int, BasicBlock *>> order;
+        for(int b : blocks[l])
+            order.emplace_back(2 * b + 1, dt.rpo[b]);
+        for(auto ph : inner_ph[l])
+            order.emplace_back(2 * dt.getIndex(ph->getTerminator()->target[0]), ph);
+        sort(order.begin(), order.end());
+        for(auto &o : order)
+            scan(o.second, o.first / 2);
+
+        if(moved.empty()) continue;
+        int p = li.parent[l];
+        BasicBlock *ph = createPreheader(dt.rpo[h], outside);
+        ph_loop[ph] = p;
+        if(p >= 0) inner_ph[p].push_back(ph);
+        auto pos = prev(ph->insts.end());
+        for(auto v : moved){
+            v->bb = ph;
+            ph->insts.insert(pos, v);
+        }
+        hoisted += moved.size();
+    }
+    if(hoisted > 0)
+        func->buildCFG();
+    return hoisted;
+}
@@ -0,0 +1,75 @@
+#include "pass.h"
+using namespace std;
+
+/**
+ * 循环嵌套。回边 b->h 指h支配b，h是循环的头部。按逆rpo的顺序处理头部，内层循环先处理，
+ * 外层循环沿前驱回溯时遇到已经属于内层循环的块，直接跳到内层循环最外层的头部继续
+ * (用并查集找，与记录嵌套关系的parent分开)，每个块只被回溯常数次。
+*/
+void LoopInfo::build(const DominatorTree &dt){
+    int n = dt.rpo.size();
+    header.clear();
+    parent.clear();
+    depth.clear();
+    loop_of.assign(n, -1);
+    vector<int> up;     // 并查集，指向已知的更外层循环
+    auto outermost = [&](int l){
+        int r = l;
+        while(up[r] >= 0) r = up[r];
+        while(up[l] >= 0){
+            int p = up[l];
+            up[l] = r;
+            l = p;
+        }
+        return r;
+    };
+    vector<int> work;
+    for(int h = n - 1; h >= 0; --h){
+        work.clear();
+        for(auto p : dt.rpo[h]->preds){
+            int b = dt.getIndex(p);
+            if(b >= 0 && dt.dominates(h, b))
+                work.push_back(b);
+        }
+        if(work.empty()) continue;
+        int l = header.size();
+        header.push_back(h);
+        parent.push_back(-1);
+        up.push_back(-1);
+        loop_of[h] = l;
+        while(!work.empty()){
+            int b = work.back();
+            work.pop_back();
+            if(loop_of[b] < 0){
+                loop_of[b] = l;
+            } else {
+                int m = outermost(loop_of[b]);
+                if(m == l) continue;
+                parent[m] = l;
+                up[m] = l;
+                b = header[m];
+            }
+            for(auto p : dt.rpo[b]->preds){
+                int q = dt.getIndex(p);
+                if(q >= 0) work.push_back(q);
+            }
+        }
+    }
+    // 外层循环的编号比内层的大
+    depth.assign(header.size(), 1);
+    for(int l = header.size() - 1; l >= 0; --l){
+        if(parent[l] >= 0)
+            depth[l] = depth[parent[l]] + 1;
+    }
+}
+
+int LoopInfo::getDepth(int b) const{
+    return loop_of[b] < 0 ? 0 : depth[loop_of[b]];
+}
+
+bool LoopInfo::contains(int l, int b) const{
+    int m = loop_of[b];
+    while(m >= 0 && depth[m] > depth[l])
+        m = parent[m];
+    return m == l;
+}
@@ -1,15 +1,18 @@
 #include <cassert>
 #include <cstdio>
 #include <iostream>
-#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
 #include <memory>
+#include <functional>
 #include <string>
 #include <cstring>
 #include "AST.h"
-#include "koopa.h"
 #include "visit.h"
 #include "utils.h"
 #include "Symbol.h"
+#include "IR.h"
+#include "pass.h"
 using namespace std;
 
 // 声明 lexer 的输入, 以及 parser 函数
@@ -18,10 +21,10 @@ using namespace std;
 // 你的代码编辑器/IDE 很可能找不到这个文件, 然后会给你报错 (虽然编译不会出错)
 // 看起来会很烦人, 于是干脆采用这种看起来 dirty 但实际很有效的手段
 extern FILE *yyin;
-extern int yyparse(unique_ptr<BaseAST> &ast);
+extern int yyparse(unique_ptr<CompUnitAST> &ast);
 
 extern RiscvString rvs;
-extern KoopaString ks;
+extern IRBuilder irb;
 
 int main(int argc, const char *argv[]) {
     // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
@@ -35,8 +38,9 @@ int main(int argc, const char *argv[]) {
     yyin = fopen(input, "r");
     assert(yyin);
     
-    // 输出文件
-    ofstream fout(output);
+    // 输出文件。生成的代码边产生边写入
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
 
     // // 获取测试用例
     // ifstream ihaha(input);
@@ -48,41 +52,56 @@ int main(int argc, const char *argv[]) {
     // }
     // fhaha.close();ihaha.close();return 0;
     
+    // 每个全局变量、函数的IR一生成完，就立即优化并输出，之后释放。
+    // 小函数保留函数体供之后的函数内联，推迟到程序结束再输出，没人调用时直接删去
+    KoopaString ks;
+    function<void(Function *)> emit;
+    if(!strcmp(mode,"-koopa")){
+        // 只有要求输出 Koopa IR 时才生成文本
+        ks.setOutput(fd);
+        onGlobalVar = [&](Value *g){ Program::dumpGlobal(ks, g); };
+        emit = [&](Function *f){ Program::dumpFunction(ks, f); };
+    } else {
+        // 后端直接遍历内存中的 IR 生成 RISC-V
+        rvs.setOutput(fd);
+        onGlobalVar = [](Value *g){ VisitGlobalVar(g); };
+        emit = [](Function *f){ Visit(f); };
+    }
+    auto finish = [&](Function *f){
+        // 完全展开后每一遍的归纳变量是常量，再做一次常量传播和值编号，折叠下标、合并重复的地址计算
+        if(unrollLoops(f) > 0){
+            sccp(f);
+            gvn(f);
+        }
+        strengthReduce(f);
+        emit(f);
+        f->releaseBody();
+    };
+    onFunction = [&](Function *f){
+        if(f->isDecl()){
+            emit(f);
+            return;
+        }
+        mem2reg(f);
+        inlineCalls(f);
+        sccp(f);
+        gvn(f);
+        licm(f);
+        if(!keepForInline(f))
+            finish(f);
+    };
+
     // 调用 parser 函数, parser 函数会进一步调用 lexer 解析输入文件的
-    unique_ptr<BaseAST> base_ast;
+    // 语法分析的同时完成IR生成和代码生成
     unique_ptr<CompUnitAST> ast;
-    auto ret = yyparse(base_ast);
+    auto ret = yyparse(ast);
     assert(!ret);
+    for(auto f : takeKeptFunctions())
+        finish(f);
 
-    ast.reset((CompUnitAST *)base_ast.release());
-    ast->Dump();
-    
-    const char *str = ks.c_str();
-
-    if(!strcmp(mode,"-koopa")){
-        fout << str; 
-        fout.close();
-        return 0;
-    }
-    // 解析字符串 str, 得到 Koopa IR 程序
-    koopa_program_t program;
-    koopa_error_code_t err_c = koopa_parse_from_string(str, &program);
-    assert(err_c == KOOPA_EC_SUCCESS);  // 确保解析时没有出错
-    // 创建一个 raw program builder, 用来构建 raw program
-    koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
-    // 将 Koopa IR 程序转换为 raw program
-    koopa_raw_program_t raw = koopa_build_raw_program(builder, program);
-    // 释放 Koopa IR 程序占用的内存
-    koopa_delete_program(program);
-    // 处理 raw program
-    // TODO: Implement Code here:
-    Visit(raw);
-    fout << rvs.c_str();
-    fout.close();
-    // 处理完成, 释放 raw program builder 占用的内存
-    // 注意, raw program 中所有的指针指向的内存均为 raw program builder 的内存
-    // 所以不要在 raw program 处理完毕之前释放 builder
-    koopa_delete_raw_program_builder(builder);
+    ks.flush();
+    rvs.flush();
+    close(fd);
 
     return 0;
 }
\ No newline at end of file
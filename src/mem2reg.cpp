@@ -0,0 +1,244 @@
+#include "pass.h"
+#include <cassert>
+using namespace std;
+
+/**
+ * SSA构造。Cytron et al. 的算法：在支配边界的迭代闭包上插入phi，
+ * 再沿支配树重命名。phi用基本块参数表示，前驱跳转时传入对应的值。
+ * 只在变量活跃的地方插入参数（pruned SSA），最后删掉只有一个来源的参数。
+*/
+
+// alloc出来的变量只被load和store访问，地址没有被传出去，就可以提升
+static bool isPromotable(Value *alloc){
+    if(alloc->ty->base->tag == IRType::ARRAY)
+        return false;
+    for(auto u : alloc->users){
+        if(u->tag == Value::LOAD)
+            continue;
+        if(u->tag == Value::STORE && u->ops[1] == alloc && u->ops[0] != alloc)
+            continue;
+        return false;
+    }
+    return true;
+}
+
+// 对所有前驱传给bb第i个参数的值调用f(跳转指令, 目标下标)
+template<typename F>
+static void forEachIncoming(BasicBlock *bb, F f){
+    for(auto pred : bb->preds){
+        Value *term = pred->getTerminator();
+        int n = term->tag == Value::BRANCH ? 2 : 1;
+        for(int k = 0; k < n; ++k){
+            if(term->target[k] == bb)
+                f(term, k);
+        }
+    }
+}
+
+// 删除冗余的基本块参数：没有被使用的，或者除自身以外只有一个来源的
+static void removeTrivialParams(Function *func){
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for(auto bb : func->bbs){
+            for(size_t i = 0; i < bb->params.size(); ){
+                Value *p = bb->params[i];
+                Value *same = nullptr;
+                bool trivial = true;
+                forEachIncoming(bb, [&](Value *term, int k){
+                    Value *a = term->ops[term->argBegin(k) + i];
+                    if(a == p || a == same) return;
+                    if(same != nullptr) trivial = false;
+                    same = a;
+                });
+                if(!trivial && !p->users.empty()){
+                    ++i;
+                    continue;
+                }
+                if(!p->users.empty())
+                    p->replaceAllUsesWith(same != nullptr ? same : func->program->getUndef(p->ty));
+                forEachIncoming(bb, [&](Value *term, int k){
+                    term->removeArg(k, i);
+                });
+                bb->params.erase(bb->params.begin() + i);
+                for(size_t j = i; j < bb->params.size(); ++j)
+                    bb->params[j]->value = j;
+                changed = true;
+            }
+        }
+    }
+}
+
+void mem2reg(Function *func){
+    func->removeUnreachable();
+    func->buildCFG();
+    DominatorTree dt;
+    dt.build(func);
+    dt.buildFrontier();
+    int n = dt.rpo.size();
+    Program *program = func->program;
+
+    // 1. 找出可以提升的变量
+    vector<Value *> allocs;
+    unordered_map<Value *, int> var_id;
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(v->tag == Value::ALLOC && isPromotable(v)){
+                var_id[v] = allocs.size();
+                allocs.push_back(v);
+            }
+        }
+    }
+    int m = allocs.size();
+    if(m == 0) return;
+    auto varOf = [&](Value *addr){
+        auto it = var_id.find(addr);
+        return it == var_id.end() ? -1 : it->second;
+    };
+
+    // 2. 每个变量被store的基本块，以及在store之前就被load的基本块
+    vector<vector<int>> def_blocks(m), use_blocks(m);
+    vector<int> def_stamp(m, -1), use_stamp(m, -1);
+    for(int b = 0; b < n; ++b){
+        for(auto v : dt.rpo[b]->insts){
+            if(v->tag == Value::LOAD){
+                int k = varOf(v->ops[0]);
+                if(k >= 0 && def_stamp[k] != b && use_stamp[k] != b){
+                    use_stamp[k] = b;
+                    use_blocks[k].push_back(b);
+                }
+            } else if(v->tag == Value::STORE){
+                int k = varOf(v->ops[1]);
+                if(k >= 0 && def_stamp[k] != b){
+                    def_stamp[k] = b;
+                    def_blocks[k].push_back(b);
+                }
+            }
+        }
+    }
+
+    // 3. 对每个变量，求出它活跃的基本块，在迭代支配边界中活跃的地方插入参数
+    unordered_map<Value *, int> phi_var;
+    vector<int> is_def(n, -1), live(n, -1), has_phi(n, -1), in_work(n, -1);
+    vector<int> work;
+    for(int k = 0; k < m; ++k){
+        for(int b : def_blocks[k]) is_def[b] = k;
+        work = use_blocks[k];
+        for(int b : work) live[b] = k;
+        while(!work.empty()){
+            int b = work.back();
+            work.pop_back();
+            for(auto p : dt.rpo[b]->preds){
+                int j = dt.getIndex(p);
+                if(live[j] != k && is_def[j] != k){
+                    live[j] = k;
+                    work.push_back(j);
+                }
+            }
+        }
+
+        work = def_blocks[k];
+        for(int b : work) in_work[b] = k;
+        while(!work.empty()){
+            int b = work.back();
+            work.pop_back();
+            for(int f : dt.frontier[b]){
+                if(has_phi[f] == k || live[f] != k)
+                    continue;
+                has_phi[f] = k;
+                BasicBlock *bb = dt.rpo[f];
+                Value *p = func->newValue(Value::BLOCK_ARG, allocs[k]->ty->base);
+                p->bb = bb;
+                p->value = bb->params.size();
+                bb->params.push_back(p);
+                phi_var[p] = k;
+                if(in_work[f] != k){
+                    in_work[f] = k;
+                    work.push_back(f);
+                }
+            }
+        }
+    }
+
+    // 4. 沿支配树重命名。stacks[k]为变量k当前的值，undo记录压栈的变量以便回溯
+    vector<vector<Value *>> stacks(m);
+    vector<int> undo;
+    vector<Value *> undefs(m, nullptr);
+    auto current = [&](int k){
+        if(!stacks[k].empty())
+            return stacks[k].back();
+        if(undefs[k] == nullptr)
+            undefs[k] = program->getUndef(allocs[k]->ty->base);
+        return undefs[k];
+    };
+    // (基本块, 下一个要访问的孩子, 进入时undo的长度)
+    struct Frame{ int b; size_t child; size_t undo_size; };
+    vector<Frame> stk;
+    stk.push_back(Frame{0, 0, 0});
+    bool enter = true;
+    while(!stk.empty()){
+        Frame &fr = stk.back();
+        if(enter){
+            BasicBlock *bb = dt.rpo[fr.b];
+            for(auto p : bb->params){
+                auto it = phi_var.find(p);
+                if(it != phi_var.end()){
+                    stacks[it->second].push_back(p);
+                    undo.push_back(it->second);
+                }
+            }
+            for(auto it = bb->insts.begin(); it != bb->insts.end(); ){
+                Value *v = *it;
+                int k;
+                if(v->tag == Value::LOAD && (k = varOf(v->ops[0])) >= 0){
+                    v->replaceAllUsesWith(current(k));
+                    v->dropOperands();
+                    it = bb->insts.erase(it);
+                } else if(v->tag == Value::STORE && (k = varOf(v->ops[1])) >= 0){
+                    stacks[k].push_back(v->ops[0]);
+                    undo.push_back(k);
+                    v->dropOperands();
+                    it = bb->insts.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            // 给后继的参数传值
+            Value *term = bb->getTerminator();
+            if(term != nullptr && term->tag != Value::RETURN){
+                int nt = term->tag == Value::BRANCH ? 2 : 1;
+                for(int t = 0; t < nt; ++t){
+                    for(auto p : term->target[t]->params){
+                        auto it = phi_var.find(p);
+                        if(it != phi_var.end())
+                            term->addArg(t, current(it->second));
+                    }
+                }
+            }
+            enter = false;
+        }
+        if(fr.child < dt.children[fr.b].size()){
+            int c = dt.children[fr.b][fr.child++];
+            stk.push_back(Frame{c, 0, undo.size()});
+            enter = true;
+        } else {
+            while(undo.size() > fr.undo_size){
+                stacks[undo.back()].pop_back();
+                undo.pop_back();
+            }
+            stk.pop_back();
+        }
+    }
+
+    // 5. 删除已经提升的alloc
+    for(auto bb : func->bbs){
+        for(auto it = bb->insts.begin(); it != bb->insts.end(); ){
+            if((*it)->tag == Value::ALLOC && varOf(*it) >= 0)
+                it = bb->insts.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    removeTrivialParams(func);
+}
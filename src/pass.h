@@ -0,0 +1,79 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include "IR.h"
+
+/**
+ * 在IR上进行的分析与优化
+*/
+
+// 支配树，只包含从entry可达的基本块。基本块用它在逆后序中的下标表示
+class DominatorTree{
+public:
+    std::vector<BasicBlock *> rpo;                  // 逆后序
+    std::unordered_map<BasicBlock *, int> index;    // 基本块在rpo中的下标
+    std::vector<int> idom;                          // 直接支配者，entry的为自己
+    std::vector<std::vector<int>> children;         // 支配树上的孩子
+    std::vector<std::vector<int>> frontier;         // 支配边界，调用buildFrontier后才有
+
+    // 计算前需要保证各基本块的preds是最新的
+    void build(Function *func);
+    void buildFrontier();
+    bool dominates(int a, int b) const;
+    int getIndex(BasicBlock *bb) const;
+
+private:
+    std::vector<int> pre, post;     // 支配树上DFS的进出时间戳
+};
+
+// 循环嵌套，只包含从entry可达的基本块。基本块用它在逆后序中的下标表示，循环用编号表示，内层循环的编号比外层的小
+class LoopInfo{
+public:
+    std::vector<int> header;    // 循环的头部
+    std::vector<int> parent;    // 直接包含它的外层循环，没有为-1
+    std::vector<int> depth;     // 嵌套深度，最外层为1
+    std::vector<int> loop_of;   // 基本块所在的最内层循环，不在循环中为-1
+
+    // 计算前需要保证各基本块的preds是最新的
+    void build(const DominatorTree &dt);
+    int getDepth(int b) const;
+    bool contains(int l, int b) const;
+};
+
+// 两个地址是否可能指向同一个位置，只比较地址所指的对象和常量偏移
+bool mayAlias(Value *p, Value *q);
+// 调用是否可能写内存
+bool mayWrite(Value *call);
+
+// 把只被load/store访问的局部变量提升为SSA值，用基本块参数代替phi
+void mem2reg(Function *func);
+
+// 函数内联：按代价把调用保留函数的地方换成它的函数体，返回内联的调用个数
+int inlineCalls(Function *func);
+// 优化到一半的函数是否保留函数体供之后定义的函数内联，保留的函数推迟到程序结束再完成优化并输出
+bool keepForInline(Function *func);
+// 程序结束时仍然被调用的保留函数，按定义的顺序；其余保留的函数在这里释放函数体
+std::vector<Function *> takeKeptFunctions();
+
+// 稀疏条件常量传播，删除算出常量的指令和不会执行的基本块，返回删除的指令数和基本块数
+struct SCCPResult{
+    int insts;
+    int blocks;
+};
+SCCPResult sccp(Function *func);
+
+// 全局值编号，合并支配树上重复的运算、地址计算和没有被store或调用隔开的load，返回删除的指令数
+int gvn(Function *func);
+
+// 把循环中不变的运算、地址计算和不会被循环改写的load提到循环前，返回提出的指令数
+int licm(Function *func);
+
+// 展开只有一个基本块的计数循环：次数是常量且不多的完全展开，其余展开4次并保留原来的循环处理余下的迭代，
+// 返回完全展开的循环个数
+int unrollLoops(Function *func);
+
+// 归纳变量的强度削弱：以归纳变量为下标的地址改为每轮递增的指针，返回改写的地址计算个数
+int strengthReduce(Function *func);
+
+// 基本块的发射顺序，entry在最前，尽量让执行频率高的边落下去
+std::vector<BasicBlock *> layoutBlocks(Function *func);
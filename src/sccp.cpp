@@ -0,0 +1,205 @@
+#include "pass.h"
+#include <cassert>
+using namespace std;
+
+/**
+ * 稀疏条件常量传播。Wegman, Zadeck 的算法：每个SSA值取 未知 / 常量c / 不是常量 三种状态，
+ * 只沿可能执行的边传播。基本块参数取所有可能执行的入边上实参的交，
+ * 条件是常量的分支只有一条出边可能执行。最后把常量替换进使用处，
+ * 条件确定的br改为jump，删除不会执行的基本块。
+*/
+
+namespace {
+struct Lattice{
+    enum STATE { UNKNOWN, CONST, VARYING };
+    STATE state;
+    int c;
+    bool operator==(const Lattice &o) const { return state == o.state && (state != CONST || c == o.c); }
+    bool operator!=(const Lattice &o) const { return !(*this == o); }
+};
+
+class SCCPSolver{
+public:
+    unordered_map<Value *, Lattice> lat;
+    unordered_map<BasicBlock *, bool> exec_block;
+    unordered_map<Value *, int> exec_edge;      // 跳转指令的第k个目标可能执行时第k位为1
+    vector<BasicBlock *> block_work;
+    vector<Value *> value_work;
+
+    Lattice get(Value *v){
+        if(v->tag == Value::INTEGER)
+            return Lattice{Lattice::CONST, v->value};
+        // undef当作不是常量，所有值在可能执行的基本块中都不会停留在未知
+        if(v->tag != Value::BINARY && v->tag != Value::BLOCK_ARG)
+            return Lattice{Lattice::VARYING, 0};
+        auto it = lat.find(v);
+        return it == lat.end() ? Lattice{Lattice::UNKNOWN, 0} : it->second;
+    }
+
+    void set(Value *v, Lattice l){
+        Lattice &cur = lat[v];
+        if(cur == l) return;
+        cur = l;
+        value_work.push_back(v);
+    }
+
+    bool isExecutable(BasicBlock *bb){
+        auto it = exec_block.find(bb);
+        return it != exec_block.end() && it->second;
+    }
+
+    /**
+     * 第k条出边可能执行，或者边上实参的状态变了。只把这条边上的实参交进目标的参数，
+     * 状态只会单调地往"不是常量"变，不需要重新扫描所有入边
+    */
+    void markEdge(Value *term, int k){
+        int &mask = exec_edge[term];
+        BasicBlock *s = term->target[k];
+        bool first = !(mask >> k & 1);
+        mask |= 1 << k;
+        for(size_t i = 0; i < s->params.size(); ++i)
+            meet(s->params[i], get(term->ops[term->argBegin(k) + i]));
+        if(first && !isExecutable(s)){
+            exec_block[s] = true;
+            block_work.push_back(s);
+        }
+    }
+
+    // 基本块参数: 所有可能执行的入边上实参的交
+    void meet(Value *param, Lattice a){
+        Lattice l = get(param);
+        if(a.state == Lattice::UNKNOWN || l.state == Lattice::VARYING)
+            return;
+        if(l.state == Lattice::UNKNOWN)
+            set(param, a);
+        else if(l != a)
+            set(param, Lattice{Lattice::VARYING, 0});
+    }
+
+    void visit(Value *v){
+        switch(v->tag){
+        case Value::BINARY:{
+            Lattice a = get(v->ops[0]), b = get(v->ops[1]);
+            // 乘0、与0时不管另一个操作数是什么，结果都是0
+            bool zero = (a.state == Lattice::CONST && a.c == 0) || (b.state == Lattice::CONST && b.c == 0);
+            if(zero && (v->op == Value::MUL || v->op == Value::AND))
+                set(v, Lattice{Lattice::CONST, 0});
+            else if(a.state == Lattice::VARYING || b.state == Lattice::VARYING)
+                set(v, Lattice{Lattice::VARYING, 0});
+            else if(a.state == Lattice::CONST && b.state == Lattice::CONST)
+                set(v, Lattice{Lattice::CONST, foldBinary(v->op, a.c, b.c)});
+            break;
+        }
+        case Value::BRANCH:{
+            Lattice c = get(v->ops[0]);
+            if(c.state == Lattice::CONST){
+                markEdge(v, c.c != 0 ? 0 : 1);
+            } else if(c.state == Lattice::VARYING){
+                markEdge(v, 0);
+                markEdge(v, 1);
+            }
+            break;
+        }
+        case Value::JUMP:
+            markEdge(v, 0);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void solve(Function *func){
+        exec_block[func->bbs[0]] = true;
+        block_work.push_back(func->bbs[0]);
+        while(!block_work.empty() || !value_work.empty()){
+            while(!value_work.empty()){
+                Value *v = value_work.back();
+                value_work.pop_back();
+                for(auto u : v->users){
+                    if(isExecutable(u->bb))
+                        visit(u);
+                }
+            }
+            if(!block_work.empty()){
+                BasicBlock *bb = block_work.back();
+                block_work.pop_back();
+                for(auto v : bb->insts)
+                    visit(v);
+            }
+        }
+    }
+};
+}
+
+SCCPResult sccp(Function *func){
+    SCCPResult res{0, 0};
+    func->buildCFG();
+    SCCPSolver solver;
+    solver.solve(func);
+    Program *program = func->program;
+
+    // 1. 常量替换进使用处，删去算出常量的指令
+    for(auto bb : func->bbs){
+        if(!solver.isExecutable(bb)){
+            res.insts += bb->insts.size();
+            continue;
+        }
+        for(auto it = bb->insts.begin(); it != bb->insts.end(); ){
+            Value *v = *it;
+            Lattice l = solver.get(v);
+            if(v->tag == Value::BINARY && l.state == Lattice::CONST){
+                v->replaceAllUsesWith(program->getInt(l.c));
+                v->dropOperands();
+                it = bb->insts.erase(it);
+                ++res.insts;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // 2. 只有一条出边可能执行的br改为jump
+    for(auto bb : func->bbs){
+        if(!solver.isExecutable(bb)) continue;
+        Value *term = bb->getTerminator();
+        if(term->tag != Value::BRANCH) continue;
+        int mask = solver.exec_edge[term];
+        assert(mask != 0);
+        if(mask == 3) continue;
+        int k = mask == 1 ? 0 : 1;
+        Value *j = func->newValue(Value::JUMP, IRType::getUnit());
+        j->bb = bb;
+        j->target[0] = term->target[k];
+        for(int i = term->argBegin(k); i < term->argEnd(k); ++i)
+            j->addArg(0, term->ops[i]);
+        term->dropOperands();
+        bb->insts.back() = j;
+    }
+
+    // 3. 删除不会执行的基本块，再删去值是常量的基本块参数
+    res.blocks = func->removeUnreachable();
+    func->buildCFG();
+    for(auto bb : func->bbs){
+        bool changed = false;
+        for(size_t i = bb->params.size(); i-- > 0; ){
+            Lattice l = solver.get(bb->params[i]);
+            if(l.state != Lattice::CONST) continue;
+            bb->params[i]->replaceAllUsesWith(program->getInt(l.c));
+            for(auto p : bb->preds){
+                Value *term = p->getTerminator();
+                int n = term->tag == Value::BRANCH ? 2 : 1;
+                for(int k = 0; k < n; ++k){
+                    if(term->target[k] == bb)
+                        term->removeArg(k, i);
+                }
+            }
+            bb->params.erase(bb->params.begin() + i);
+            changed = true;
+        }
+        if(changed){
+            for(size_t j = 0; j < bb->params.size(); ++j)
+                bb->params[j]->value = j;
+        }
+    }
+    return res;
+}
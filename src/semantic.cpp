@@ -0,0 +1,247 @@
+#include "AST.h"
+#include "Symbol.h"
+#include <cassert>
+#include <vector>
+#include <string>
+using namespace std;
+
+/**
+ * 语义分析。在生成IR之前遍历一个顶层定义的AST：维护作用域，把每个左值和函数调用
+ * 绑定到它的符号，折叠常量的值、数组各维的长度和常量数组的初值，记录在符号中。
+ * 之后的Dump只通过结点上的Symbol *取信息，不再查符号表、不再重复求值。
+ * 与Dump一样用显式的栈遍历语句和表达式。
+*/
+
+extern IRBuilder irb;
+extern SymbolTableStack st;
+
+// 绑定表达式中所有的左值和函数调用，顺序无关
+void ExpAST::Bind(){
+    vector<ExpAST *> stk;
+    stk.push_back(this);
+    while(!stk.empty()){
+        ExpAST *e = stk.back();
+        stk.pop_back();
+        switch(e->tag){
+        case LVAL:
+            e->lval->sym = st.lookup(e->lval->ident);
+            for(auto c : e->lval->exps)
+                stk.push_back(c);
+            break;
+        case CALL:
+            e->sym = st.lookup(e->ident);
+            if(e->func_params){
+                for(auto c : e->func_params->exps)
+                    stk.push_back(c);
+            }
+            break;
+        case NUMBER:
+            break;
+        case UNARY:
+            stk.push_back(e->lhs);
+            break;
+        default:
+            stk.push_back(e->lhs);
+            stk.push_back(e->rhs);
+            break;
+        }
+    }
+}
+
+// 常量表达式: 绑定后求值
+static int fold(ExpAST *e){
+    e->Bind();
+    return e->getValue();
+}
+
+static void foldLen(ASTList<ExpAST *> &const_exps, vector<int> &len){
+    for(auto ce : const_exps)
+        len.push_back(fold(ce));
+}
+
+void FuncDefAST::Bind(){
+    // 函数名加到符号表
+    sym = st.insertFUNC(ident, btype->tag == BTypeAST::INT ? SysYType::SYSY_FUNC_INT : SysYType::SYSY_FUNC_VOID);
+
+    // 参数和函数体在同一个作用域
+    st.alloc();
+    vector<string> var_names;   //KoopaIR参数列表的名字
+    vector<IRType *> var_types;
+    if(func_params != nullptr){
+        for(auto fp : func_params->func_f_params){
+            var_names.push_back(st.getVarName(idents.str(fp->ident)));
+            var_types.push_back(fp->Bind());
+        }
+    }
+    IRType *ret_ty = btype->tag == BTypeAST::INT ? IRType::getInt32() : IRType::getUnit();
+    sym->func = irb.createFunction(sym->name, ret_ty, var_types, var_names);
+
+    block->Bind(false);
+    st.quit();
+}
+
+IRType *FuncFParamAST::Bind(){
+    if(tag == VARIABLE){
+        sym = st.insertINT(ident);
+        return IRType::getInt32();
+    }
+    // a[][3] 的类型记为 a[-1][3]，即 *[i32, 3]
+    vector<int> len;
+    len.push_back(-1);
+    foldLen(const_exps, len);
+    sym = st.insertArray(ident, len, SysYType::SYSY_ARRAY);
+    len.erase(len.begin());
+    return IRType::getPointer(IRType::getArray(len));
+}
+
+void DeclAST::Bind(){
+    if(tag == VAR_DECL){
+        for(auto var_def : var_decl->var_defs)
+            var_def->Bind();
+    } else {
+        for(auto const_def : const_decl->const_defs)
+            const_def->Bind();
+    }
+}
+
+void ConstDefAST::Bind(){
+    if(tag == VARIABLE){
+        int v = fold(const_init_val->const_exp);
+        sym = st.insertINTCONST(ident, v);
+        return;
+    }
+    vector<int> len;
+    foldLen(const_exps, len);
+    sym = st.insertArray(ident, len, SysYType::SYSY_ARRAY_CONST);
+    const_init_val->getInitVal(sym->inits, 0, len, 0);
+}
+
+// 子数组第一个元素展平后的下标为base，类型为len的第dim维及以下
+void ConstInitValAST::getInitVal(SparseInit<int> &init, int base, const std::vector<int> &len, size_t dim) const{
+    int n = len.size() - dim;   // 子数组的维数
+    vector<int> width(n);       // width[j]: 子数组第j维及以下的元素个数
+    width[n - 1] = len.back();
+    for(int j = n - 2; j >= 0; --j){
+        width[j] = width[j + 1] * len[dim + j];
+    }
+    int i = 0;  // 指向下一步要填写的内存位置
+    for(auto &init_val : inits){
+        if(init_val->tag == CONST_EXP){
+            int v = fold(init_val->const_exp);
+            if(v != 0)
+                init.emplace_back(base + i, v);
+            ++i;
+        } else {
+            assert(n > 1);  // 对一维数组初始化不可能再套一个Aggregate{{}}
+            int j = n - 1;
+            if(i == 0){
+                j = 1;
+            } else{
+                j = n - 1;
+                for(; j >= 0; --j){
+                    if(i % width[j] != 0)
+                        break;
+                }
+                assert(j < n - 1); // 保证整除最后一维
+                ++j;    // j 指向最大的可除的维度
+            }
+            init_val->getInitVal(init, base + i, len, dim + j);
+            i += width[j];
+        }
+        if(i >= width[0]) break;
+    }
+}
+
+void VarDefAST::Bind(){
+    if(tag == VARIABLE){
+        sym = st.insertINT(ident);
+    } else {
+        vector<int> len;
+        foldLen(const_exps, len);
+        sym = st.insertArray(ident, len, SysYType::SYSY_ARRAY);
+    }
+    // 初值中可以使用刚定义的变量
+    if(init_val != nullptr)
+        init_val->Bind();
+}
+
+void InitValAST::Bind(){
+    if(tag == EXP){
+        exp->Bind();
+        return;
+    }
+    for(auto init_val : inits)
+        init_val->Bind();
+}
+
+/**
+ * 语句和语句块。工作栈中按逆序压入待处理的项，弹出时处理：
+ * 语句块压入它的各项和一个退出作用域的标记，语句直接绑定其中的表达式，再压入子语句。
+*/
+namespace {
+struct BindItem{
+    enum KIND { BLOCK, NEW_BLOCK, QUIT, DECL, STMT };
+    KIND kind;
+    BlockAST *block;
+    DeclAST *decl;
+    StmtAST *stmt;
+};
+}
+
+static void bindItems(BindItem first){
+    vector<BindItem> stk;
+    stk.push_back(first);
+    while(!stk.empty()){
+        BindItem item = stk.back();
+        stk.pop_back();
+        switch(item.kind){
+        case BindItem::NEW_BLOCK:
+        case BindItem::BLOCK:{
+            // 不新建作用域的语句块(函数体)由调用者退出作用域
+            BlockAST *b = item.block;
+            if(item.kind == BindItem::NEW_BLOCK){
+                st.alloc();
+                stk.push_back(BindItem{BindItem::QUIT, nullptr, nullptr, nullptr});
+            }
+            for(size_t i = b->block_items.size(); i-- > 0; ){
+                BlockItemAST *bi = b->block_items[i];
+                if(bi->tag == BlockItemAST::DECL)
+                    stk.push_back(BindItem{BindItem::DECL, nullptr, bi->decl, nullptr});
+                else
+                    stk.push_back(BindItem{BindItem::STMT, nullptr, nullptr, bi->stmt});
+            }
+            break;
+        }
+        case BindItem::QUIT:
+            st.quit();
+            break;
+        case BindItem::DECL:
+            item.decl->Bind();
+            break;
+        case BindItem::STMT:{
+            StmtAST *s = item.stmt;
+            if(s->exp)
+                s->exp->Bind();
+            if(s->tag == StmtAST::ASSIGN){
+                s->lval->sym = st.lookup(s->lval->ident);
+                for(auto e : s->lval->exps)
+                    e->Bind();
+            }
+            if(s->tag == StmtAST::BLOCK)
+                stk.push_back(BindItem{BindItem::NEW_BLOCK, s->block, nullptr, nullptr});
+            if(s->tag == StmtAST::WHILE)
+                stk.push_back(BindItem{BindItem::STMT, nullptr, nullptr, s->stmt});
+            if(s->tag == StmtAST::IF){
+                if(s->else_stmt != nullptr)
+                    stk.push_back(BindItem{BindItem::STMT, nullptr, nullptr, s->else_stmt});
+                stk.push_back(BindItem{BindItem::STMT, nullptr, nullptr, s->if_stmt});
+            }
+            break;
+        }
+        }
+    }
+}
+
+void BlockAST::Bind(bool new_symbol_tb){
+    bindItems(BindItem{new_symbol_tb ? BindItem::NEW_BLOCK : BindItem::BLOCK, this, nullptr, nullptr});
+}
@@ -0,0 +1,319 @@
+#include "pass.h"
+#include <cassert>
+#include <list>
+#include <map>
+#include <tuple>
+using namespace std;
+
+/**
+ * 归纳变量的强度削弱。循环头部的参数p若在每条回边上都传入p+s(s为常量)，p就是基本归纳变量。
+ * 循环中的地址 getelemptr/getptr x, p+c (x是循环不变量) 即 q+c，其中 q = getelemptr x, p
+ * 每轮增加s个元素，于是给头部加一个指针参数q：进入循环时传入 getelemptr x, p的初值，
+ * 回边上传入 getptr q, s，原来的地址换成 getptr q, c，常量下标在后端合并进lw/sw的偏移，
+ * 每轮只需一条加法，不再有乘法或移位。已经换成 getptr q, c 的地址再以循环不变量下标取元素时，
+ * 同样是每轮增加固定元素个数的指针，如矩阵乘法中按列遍历的 b[k][j]。
+ * Koopa IR中不能比较指针，循环的退出条件仍然用原来的归纳变量，只有它不再有其它用处时才删去。
+*/
+
+static const int MAX_POINTER_IVS = 6;       // 每个循环最多新增的指针参数，避免寄存器不够用
+
+namespace {
+// 指针归纳变量: 头部参数q，每轮增加step个元素
+struct PointerIV{
+    Value *q;
+    int step;
+    vector<Value *> init;       // 每条进入循环的边上q的初值，与outside一一对应
+};
+}
+
+// 在基本块末尾的跳转指令之前插入指令
+static Value *insertBeforeTerminator(BasicBlock *bb, Value::TAG tag, IRType *ty, Value *a, Value *b){
+    Value *v = bb->func->newValue(tag, ty);
+    v->bb = bb;
+    v->addOperand(a);
+    v->addOperand(b);
+    bb->insts.insert(prev(bb->insts.end()), v);
+    return v;
+}
+
+// v = root + c，root是基本块参数。不是这种形式时返回nullptr
+static Value *affineRoot(Value *v, int &c){
+    c = 0;
+    while(v->tag == Value::BINARY){
+        if(v->op == Value::ADD && v->ops[1]->tag == Value::INTEGER){
+            c += v->ops[1]->value;
+            v = v->ops[0];
+        } else if(v->op == Value::ADD && v->ops[0]->tag == Value::INTEGER){
+            c += v->ops[0]->value;
+            v = v->ops[1];
+        } else if(v->op == Value::SUB && v->ops[1]->tag == Value::INTEGER){
+            c -= v->ops[1]->value;
+            v = v->ops[0];
+        } else {
+            return nullptr;
+        }
+    }
+    return v->tag == Value::BLOCK_ARG ? v : nullptr;
+}
+
+// 跳转到target时传递的参数
+static vector<Value *> edgeArgs(Value *term, BasicBlock *target){
+    return term->getArgs(term->target[0] == target ? 0 : 1);
+}
+
+// 删掉只用来计算自己下一轮的值的参数，如地址都已改写的归纳变量
+static void removeDeadIV(BasicBlock *header, int i, const vector<BasicBlock *> &preds){
+    Value *p = header->params[i];
+    vector<Value *> chain{p};
+    unordered_map<Value *, bool> in_chain{{p, true}};
+    for(size_t j = 0; j < chain.size(); ++j){
+        for(auto u : chain[j]->users){
+            if(in_chain.count(u)) continue;
+            if(u->tag == Value::BINARY || u->tag == Value::GET_PTR || u->tag == Value::GET_ELEM_PTR){
+                in_chain[u] = true;
+                chain.push_back(u);
+            } else if(u->tag == Value::JUMP || u->tag == Value::BRANCH){
+                // 只能作为p自己的实参
+                int nt = u->tag == Value::BRANCH ? 2 : 1;
+                for(int k = 0; k < nt; ++k){
+                    for(int a = u->argBegin(k); a < u->argEnd(k); ++a){
+                        if(u->ops[a] == chain[j] && (u->target[k] != header || a - u->argBegin(k) != i))
+                            return;
+                    }
+                }
+                if(u->tag == Value::BRANCH && u->ops[0] == chain[j])
+                    return;
+            } else {
+                return;
+            }
+        }
+    }
+    for(auto pred : preds){
+        Value *term = pred->getTerminator();
+        int nt = term->tag == Value::BRANCH ? 2 : 1;
+        for(int k = 0; k < nt; ++k){
+            if(term->target[k] != header) continue;
+            Value *a = term->ops[term->argBegin(k) + i];
+            term->removeArg(k, i);
+            // 进入循环时算的初值也不再需要
+            if(!in_chain.count(a) && a->users.empty() && (a->tag == Value::GET_PTR || a->tag == Value::GET_ELEM_PTR)){
+                a->dropOperands();
+                a->bb->insts.remove(a);
+                a->bb = nullptr;
+            }
+        }
+    }
+    for(size_t j = 1; j < chain.size(); ++j){
+        chain[j]->dropOperands();
+        chain[j]->bb->insts.remove(chain[j]);
+    }
+    header->params.erase(header->params.begin() + i);
+    for(size_t j = i; j < header->params.size(); ++j)
+        header->params[j]->value = j;
+}
+
+int strengthReduce(Function *func){
+    func->buildCFG();
+    DominatorTree dt;
+    dt.build(func);
+    LoopInfo li;
+    li.build(dt);
+    int m = li.header.size();
+    int n = dt.rpo.size();
+    int replaced = 0;
+    vector<vector<int>> blocks(m);
+    for(int b = 0; b < n; ++b){
+        if(li.loop_of[b] >= 0)
+            blocks[li.loop_of[b]].push_back(b);
+    }
+    // 在循环l外定义的值
+    auto invariant = [&](int l, Value *v){
+        if(v->isConst() || v->bb == nullptr) return true;
+        int b = dt.getIndex(v->bb);
+        return b < 0 || !li.contains(l, b);
+    };
+
+    // 前驱块中已经算好的初值 (前驱, tag, 指针, 下标) -> 地址。部分展开的守卫同时是两个循环的前驱，初值相同
+    map<tuple<BasicBlock *, int, Value *, Value *>, Value *> inits;
+
+    for(int l = 0; l < m; ++l){
+        BasicBlock *header = dt.rpo[li.header[l]];
+        vector<BasicBlock *> latches, outside;
+        for(auto p : header->preds){
+            int b = dt.getIndex(p);
+            if(b >= 0 && li.contains(l, b)) latches.push_back(p);
+            else outside.push_back(p);
+        }
+        if(latches.empty() || outside.empty()) continue;
+        // 两个目标都是头部的br不好区分边，不处理
+        bool twice = false;
+        for(auto p : header->preds){
+            Value *term = p->getTerminator();
+            if(term->tag == Value::BRANCH && term->target[0] == term->target[1])
+                twice = true;
+        }
+        if(twice) continue;
+
+        // 1. 基本归纳变量: 参数下标 -> 每轮的增量
+        unordered_map<Value *, int> iv_step;
+        for(size_t i = 0; i < header->params.size(); ++i){
+            Value *p = header->params[i];
+            if(p->ty->tag != IRType::INT32) continue;
+            bool ok = true;
+            int step = 0;
+            for(auto latch : latches){
+                int c;
+                Value *a = edgeArgs(latch->getTerminator(), header)[i];
+                if(affineRoot(a, c) != p || c == 0 || (step != 0 && c != step)){
+                    ok = false;
+                    break;
+                }
+                step = c;
+            }
+            if(ok) iv_step[p] = step;
+        }
+        if(iv_step.empty()) continue;
+
+        // 2. 按rpo的顺序找出可以改写的地址计算
+        map<tuple<int, Value *, Value *>, PointerIV> groups;   // (tag, x, p或下标) -> 指针归纳变量
+        unordered_map<Value *, pair<PointerIV *, int>> desc;   // 已改写的地址 = getptr q, c
+        auto newIV = [&](Value::TAG tag, IRType *ty, Value *x, Value *idx, int step,
+                         const vector<Value *> &x_init, const vector<Value *> &idx_init){
+            PointerIV iv;
+            iv.step = step;
+            iv.q = func->newValue(Value::BLOCK_ARG, ty);
+            iv.q->bb = header;
+            iv.q->value = header->params.size();
+            header->params.push_back(iv.q);
+            for(size_t e = 0; e < outside.size(); ++e){
+                Value *a = x_init.empty() ? x : x_init[e], *b = idx_init.empty() ? idx : idx_init[e];
+                Value *&init = inits[make_tuple(outside[e], (int)tag, a, b)];
+                if(init == nullptr || init->bb == nullptr)
+                    init = insertBeforeTerminator(outside[e], tag, ty, a, b);
+                iv.init.push_back(init);
+            }
+            return iv;
+        };
+        // 改写成功返回true
+        auto rewrite = [&](Value *v, list<Value *>::iterator pos){
+            Value *x = v->ops[0], *idx = v->ops[1];
+            PointerIV *iv = nullptr;
+            int c = 0;
+            auto d = desc.find(x);
+            if(idx->isConst()){
+                return false;
+            } else if(invariant(l, x)){
+                // getelemptr x, p+c
+                Value *p = affineRoot(idx, c);
+                if(p == nullptr || p->bb != header || !iv_step.count(p)) return false;
+                auto key = make_tuple((int)v->tag, x, p);
+                auto g = groups.find(key);
+                if(g == groups.end()){
+                    if((int)groups.size() >= MAX_POINTER_IVS) return false;
+                    vector<Value *> p_init;
+                    for(auto o : outside)
+                        p_init.push_back(edgeArgs(o->getTerminator(), header)[p->value]);
+                    g = groups.emplace(key, newIV(v->tag, v->ty, x, nullptr, iv_step[p], {}, p_init)).first;
+                }
+                iv = &g->second;
+            } else if(d != desc.end() && invariant(l, idx)){
+                // getelemptr (getptr q, c'), i: q的每个元素换算成v的元素个数
+                PointerIV *base = d->second.first;
+                int ratio = base->q->ty->base->getSize() / v->ty->base->getSize();
+                auto key = make_tuple((int)v->tag, base->q, idx);
+                auto g = groups.find(key);
+                if(g == groups.end()){
+                    if((int)groups.size() >= MAX_POINTER_IVS) return false;
+                    g = groups.emplace(key, newIV(v->tag, v->ty, nullptr, idx, base->step * ratio, base->init, {})).first;
+                }
+                iv = &g->second;
+                c = d->second.second * ratio;
+            } else {
+                return false;
+            }
+            Value *r = iv->q;
+            if(c != 0){
+                r = func->newValue(Value::GET_PTR, v->ty);
+                r->bb = v->bb;
+                r->addOperand(iv->q);
+                r->addOperand(func->program->getInt(c));
+                v->bb->insts.insert(pos, r);
+            }
+            v->replaceAllUsesWith(r);
+            v->dropOperands();
+            desc[r] = make_pair(iv, c);
+            return true;
+        };
+        for(int b : blocks[l]){
+            BasicBlock *bb = dt.rpo[b];
+            for(auto it = bb->insts.begin(); it != bb->insts.end(); ){
+                Value *v = *it;
+                if((v->tag == Value::GET_PTR || v->tag == Value::GET_ELEM_PTR) && rewrite(v, it)){
+                    it = bb->insts.erase(it);
+                    ++replaced;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        if(groups.empty()) continue;
+
+        // 3. 进入循环的边传入初值，回边传入下一轮的指针
+        for(size_t e = 0; e < outside.size(); ++e){
+            Value *term = outside[e]->getTerminator();
+            int k = term->target[0] == header ? 0 : 1;
+            // 按参数的顺序追加
+            vector<PointerIV *> ivs(header->params.size(), nullptr);
+            for(auto &g : groups)
+                ivs[g.second.q->value] = &g.second;
+            for(auto iv : ivs){
+                if(iv != nullptr)
+                    term->addArg(k, iv->init[e]);
+            }
+        }
+        for(auto latch : latches){
+            Value *term = latch->getTerminator();
+            int k = term->target[0] == header ? 0 : 1;
+            vector<PointerIV *> ivs(header->params.size(), nullptr);
+            for(auto &g : groups)
+                ivs[g.second.q->value] = &g.second;
+            for(auto iv : ivs){
+                if(iv == nullptr) continue;
+                Value *next = insertBeforeTerminator(latch, Value::GET_PTR, iv->q->ty, iv->q, func->program->getInt(iv->step));
+                term->addArg(k, next);
+            }
+        }
+
+        // 4. 删去不再需要的归纳变量
+        for(size_t i = header->params.size(); i-- > 0; )
+            removeDeadIV(header, i, header->preds);
+    }
+    if(replaced == 0) return 0;
+
+    // 5. 删去改写后不再使用的下标计算
+    vector<Value *> work;
+    auto isPure = [](Value *v){
+        return v->tag == Value::BINARY || v->tag == Value::GET_PTR || v->tag == Value::GET_ELEM_PTR;
+    };
+    for(auto bb : func->bbs){
+        for(auto v : bb->insts){
+            if(isPure(v) && v->users.empty())
+                work.push_back(v);
+        }
+    }
+    while(!work.empty()){
+        Value *v = work.back();
+        work.pop_back();
+        if(v->bb == nullptr || !v->users.empty()) continue;
+        vector<Value *> ops = v->ops;
+        v->dropOperands();
+        v->bb->insts.remove(v);
+        v->bb = nullptr;
+        for(auto o : ops){
+            if(isPure(o) && o->bb != nullptr && o->users.empty())
+                work.push_back(o);
+        }
+    }
+    func->buildCFG();
+    return replaced;
+}
@@ -13,84 +13,73 @@
 
 // 声明 lexer 函数和错误处理函数
 int yylex();
-void yyerror(std::unique_ptr<BaseAST> &ast, const char *s);
+void yyerror(std::unique_ptr<CompUnitAST> &ast, const char *s);
 
 using namespace std;
 
+// 语法分析栈的上限。默认的10000层不够分析嵌套很深的表达式和语句块，栈按需倍增，不会预先分配
+#define YYMAXDEPTH 10000000
+
+// 二元运算的表达式结点
+static BaseAST *binaryExp(Value::OP op, BaseAST *lhs, BaseAST *rhs){
+  auto exp = newAST<ExpAST>();
+  exp->tag = ExpAST::BINARY;
+  exp->op = op;
+  exp->lhs = (ExpAST *)lhs;
+  exp->rhs = (ExpAST *)rhs;
+  return exp;
+}
+
 %}
 
 // 定义 parser 函数和错误处理函数的附加参数
-%parse-param { std::unique_ptr<BaseAST> &ast }
+%parse-param { std::unique_ptr<CompUnitAST> &ast }
 
 // yylval 的定义, 我们把它定义成了一个联合体 (union)
 %union {
-  std::string *str_val;
+  int ident_val;
   int int_val;
   char char_val;
   BaseAST *ast_val;
 }
 
 // lexer 返回的所有 token 种类的声明
-// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 str_val 和 int_val
+// 注意 IDENT 和 INT_CONST 会返回 token 的值, 分别对应 ident_val(驻留的编号) 和 int_val
 %token VOID INT RETURN LESS_EQ GREAT_EQ EQUAL NOT_EQUAL AND OR CONST IF ELSE WHILE BREAK CONTINUE
-%token <str_val> IDENT
+%token <ident_val> IDENT
 %token <int_val> INT_CONST
 
 // 非终结符的类型定义
-%type <ast_val> FuncDef Block Stmt Exp PrimaryExp UnaryExp MulExp AddExp RelExp EqExp LAndExp LOrExp Decl ConstDecl VarDecl BType ConstDef VarDef ConstDefList VarDefList ConstInitVal InitVal BlockItemList BlockItem LVal ConstExp MatchedStmt OpenStmt OtherStmt GlobalFuncVarList DeclOrFuncDef FuncFParams FuncFParam FuncRParams ArrayIndexConstExpList ArrayIndexExpList InitValList ConstInitValList
+%type <ast_val> FuncDef Block Stmt Exp PrimaryExp UnaryExp MulExp AddExp RelExp EqExp LAndExp LOrExp Decl ConstDecl VarDecl BType ConstDef VarDef ConstDefList VarDefList ConstInitVal InitVal BlockItemList BlockItem LVal ConstExp MatchedStmt OpenStmt OtherStmt FuncFParams FuncFParam FuncRParams ArrayIndexConstExpList ArrayIndexExpList InitValList ConstInitValList
 %type <int_val> Number
 %type <char_val> UnaryOp 
 %%
 
 // 开始符, CompUnit ::= GlobalFuncVarList
+// 每归约出一个全局声明或函数定义，就交给CompUnitAST处理，处理完后AST内存池整体回收
 CompUnit
-  : GlobalFuncVarList {
-    auto comp_unit = unique_ptr<CompUnitAST>((CompUnitAST *)$1);
-    ast = move(comp_unit);
+  : {
+    ast.reset(new CompUnitAST());
+    ast->Begin();
+  } GlobalFuncVarList {
+    ast->End();
   }
   ;
 
 GlobalFuncVarList
-  : DeclOrFuncDef {
-    $$ = $1;
-  } 
+  : DeclOrFuncDef
+  | GlobalFuncVarList DeclOrFuncDef
   ;
-  
-GlobalFuncVarList
-  : GlobalFuncVarList DeclOrFuncDef{
-    auto comp_unit = new CompUnitAST();
-    auto comp1 = unique_ptr<CompUnitAST>((CompUnitAST *)$1);
-    auto comp2 = unique_ptr<CompUnitAST>((CompUnitAST *)$2);
-    for(auto &f : comp1->func_defs){
-        comp_unit->func_defs.emplace_back(f.release());
-    }
-    for(auto &f : comp2->func_defs){
-        comp_unit->func_defs.emplace_back(f.release());
-    }
-    for(auto &d : comp1->decls){
-        comp_unit->decls.emplace_back(d.release());
-    }
-    for(auto &d : comp2->decls){
-        comp_unit->decls.emplace_back(d.release());
-    }
-    $$ = comp_unit;
-  } 
-  ;
-
 
 DeclOrFuncDef
   : Decl {
-    auto comp_unit = new CompUnitAST();
-    comp_unit->decls.emplace_back((DeclAST *)$1);
-    $$ = comp_unit;
+    ast->DumpDecl((DeclAST *)$1);
   }
   ;
   
 DeclOrFuncDef
   : FuncDef {
-    auto comp_unit = new CompUnitAST();
-    comp_unit->func_defs.emplace_back((FuncDefAST *)$1);
-    $$ = comp_unit;
+    ast->DumpFuncDef((FuncDefAST *)$1);
   } 
   ;
 
@@ -98,10 +87,10 @@ DeclOrFuncDef
 FuncDef
   : BType IDENT '(' ')' Block {
     
-    auto func_def = new FuncDefAST();
-    func_def->btype = unique_ptr<BTypeAST>((BTypeAST *)$1);
-    func_def->ident = *unique_ptr<string>($2);
-    func_def->block = unique_ptr<BlockAST>((BlockAST *)$5);
+    auto func_def = newAST<FuncDefAST>();
+    func_def->btype = (BTypeAST *)$1;
+    func_def->ident = $2;
+    func_def->block = (BlockAST *)$5;
     $$ = func_def;
   }
   ;
@@ -109,54 +98,47 @@ FuncDef
 // FuncDef ::= FuncType IDENT '(' FuncFParams ')' Block;
 FuncDef
   : BType IDENT '(' FuncFParams ')' Block {
-    auto func_def = new FuncDefAST();
-    func_def->btype = unique_ptr<BTypeAST>((BTypeAST *)$1);
-    func_def->ident = *unique_ptr<string>($2);
-    func_def->func_params = unique_ptr<FuncFParamsAST>((FuncFParamsAST *)$4);
-    func_def->block = unique_ptr<BlockAST>((BlockAST *)$6);
+    auto func_def = newAST<FuncDefAST>();
+    func_def->btype = (BTypeAST *)$1;
+    func_def->ident = $2;
+    func_def->func_params = (FuncFParamsAST *)$4;
+    func_def->block = (BlockAST *)$6;
     $$ = func_def;
   }
   ;
 
 FuncFParams
   : FuncFParam {
-    auto func_params = new FuncFParamsAST();
-    func_params->func_f_params.emplace_back((FuncFParamAST *)$1);
+    auto func_params = newAST<FuncFParamsAST>();
+    func_params->func_f_params.push_back((FuncFParamAST *)$1);
     $$ = func_params;
-  } | FuncFParam ',' FuncFParams {
-    auto func_params = new FuncFParamsAST();
-    func_params->func_f_params.emplace_back((FuncFParamAST *)$1);
-    auto params = unique_ptr<FuncFParamsAST>((FuncFParamsAST *)($3));
-    int n = params->func_f_params.size();
-    for(int i = 0; i < n; ++i){
-        func_params->func_f_params.emplace_back(params->func_f_params[i].release());
-    }
+  } | FuncFParams ',' FuncFParam {
+    auto func_params = (FuncFParamsAST *)$1;
+    func_params->func_f_params.push_back((FuncFParamAST *)$3);
     $$ = func_params;
   }
   ;
 
 FuncFParam
   : BType IDENT {
-    auto func_param = new FuncFParamAST();
+    auto func_param = newAST<FuncFParamAST>();
     func_param->tag = FuncFParamAST::VARIABLE;
-    func_param->btype.reset((BTypeAST *)$1);
-    func_param->ident = *unique_ptr<string>($2);
+    func_param->btype = (BTypeAST *)$1;
+    func_param->ident = $2;
     $$ = func_param;
   } | BType IDENT '[' ']' {
-    auto func_param = new FuncFParamAST();
+    auto func_param = newAST<FuncFParamAST>();
     func_param->tag = FuncFParamAST::ARRAY;
-    func_param->btype.reset((BTypeAST *)$1);
-    func_param->ident = *unique_ptr<string>($2);
+    func_param->btype = (BTypeAST *)$1;
+    func_param->ident = $2;
     $$ = func_param;
   } | BType IDENT '[' ']' ArrayIndexConstExpList {
-    auto func_param = new FuncFParamAST();
+    auto func_param = newAST<FuncFParamAST>();
     func_param->tag = FuncFParamAST::ARRAY;
-    func_param->btype.reset((BTypeAST *)$1);
-    func_param->ident = *unique_ptr<string>($2);
-    unique_ptr<ArrayIndexConstExpList> p((ArrayIndexConstExpList *)$5);
-    for(auto &ce : p->const_exps){
-        func_param->const_exps.emplace_back(ce.release());
-    }
+    func_param->btype = (BTypeAST *)$1;
+    func_param->ident = $2;
+    auto p = (ArrayIndexConstExpList *)$5;
+    func_param->const_exps = p->const_exps;
     $$ = func_param;
   }
   ;
@@ -169,34 +151,29 @@ Block
 
 BlockItemList
   : {
-    auto block = new BlockAST();
+    auto block = newAST<BlockAST>();
     $$ = block;
-  } | BlockItem BlockItemList {
-    auto block = new BlockAST();
-    auto block_lst = unique_ptr<BlockAST>((BlockAST *)$2);
-    block->block_items.emplace_back((BlockItemAST *)$1);
-    int n = block_lst->block_items.size();
-    for(int i = 0; i < n; ++i){
-        block->block_items.emplace_back(block_lst->block_items[i].release());
-    }
+  } | BlockItemList BlockItem {
+    auto block = (BlockAST *)$1;
+    block->block_items.push_back((BlockItemAST *)$2);
     $$ = block;
   }
   ;
 
 BlockItem
   : Decl {
-    auto block_item = new BlockItemAST();
+    auto block_item = newAST<BlockItemAST>();
     block_item->tag = BlockItemAST::DECL;
-    block_item->decl = unique_ptr<DeclAST>((DeclAST *)$1);
+    block_item->decl = (DeclAST *)$1;
     $$ = block_item;
   }
   ;
 
 BlockItem
   : Stmt {
-    auto block_item = new BlockItemAST();
+    auto block_item = newAST<BlockItemAST>();
     block_item->tag = BlockItemAST::STMT;
-    block_item->stmt = unique_ptr<StmtAST>((StmtAST *)$1);
+    block_item->stmt = (StmtAST *)$1;
     $$ = block_item;
   }
   ;
@@ -204,18 +181,18 @@ BlockItem
 // LV4.1
 Decl 
   : ConstDecl {
-    auto decl = new DeclAST();
+    auto decl = newAST<DeclAST>();
     decl->tag = DeclAST::CONST_DECL;
-    decl->const_decl = unique_ptr<ConstDeclAST>((ConstDeclAST *)$1);
+    decl->const_decl = (ConstDeclAST *)$1;
     $$ = decl;
   }
   ;
 
 Decl 
   : VarDecl {
-    auto decl = new DeclAST();
+    auto decl = newAST<DeclAST>();
     decl->tag = DeclAST::VAR_DECL;
-    decl->var_decl = unique_ptr<VarDeclAST>((VarDeclAST *)$1);
+    decl->var_decl = (VarDeclAST *)$1;
     $$ = decl;
   }
   ;
@@ -230,11 +207,11 @@ Stmt
 
 MatchedStmt
   : IF '(' Exp ')' MatchedStmt ELSE MatchedStmt {
-    auto mat_stmt = new StmtAST();
+    auto mat_stmt = newAST<StmtAST>();
     mat_stmt->tag = StmtAST::IF;
-    mat_stmt->exp.reset((ExpAST *) $3);
-    mat_stmt->if_stmt.reset((StmtAST *)$5);
-    mat_stmt->else_stmt.reset((StmtAST *)$7);
+    mat_stmt->exp = (ExpAST *)$3;
+    mat_stmt->if_stmt = (StmtAST *)$5;
+    mat_stmt->else_stmt = (StmtAST *)$7;
     $$ = mat_stmt;
   } | OtherStmt {
     $$ = $1;
@@ -243,33 +220,33 @@ MatchedStmt
 
  OpenStmt
   : IF '(' Exp ')' Stmt {
-    auto open_stmt = new StmtAST();
+    auto open_stmt = newAST<StmtAST>();
     open_stmt->tag = StmtAST::IF;
-    open_stmt->exp.reset((ExpAST *)$3);
-    open_stmt->if_stmt.reset((StmtAST *)$5);
+    open_stmt->exp = (ExpAST *)$3;
+    open_stmt->if_stmt = (StmtAST *)$5;
     $$ = open_stmt;
   } | IF '(' Exp ')' MatchedStmt ELSE OpenStmt {
-    auto open_stmt = new StmtAST();
+    auto open_stmt = newAST<StmtAST>();
     open_stmt->tag = StmtAST::IF;
-    open_stmt->exp.reset((ExpAST *)$3);
-    open_stmt->if_stmt.reset((StmtAST *)$5);
-    open_stmt->else_stmt.reset((StmtAST *)$7);
+    open_stmt->exp = (ExpAST *)$3;
+    open_stmt->if_stmt = (StmtAST *)$5;
+    open_stmt->else_stmt = (StmtAST *)$7;
     $$ = open_stmt;
   }
   ;
 
 OtherStmt
   : RETURN Exp ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::RETURN;
-    stmt->exp = unique_ptr<ExpAST>((ExpAST *)$2);
+    stmt->exp = (ExpAST *)$2;
     $$ = stmt;
   }
   ;
 
 OtherStmt
   : RETURN  ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::RETURN;
     $$ = stmt;
   }
@@ -277,49 +254,49 @@ OtherStmt
 
 OtherStmt 
   : LVal '=' Exp ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::ASSIGN;
-    stmt->exp.reset((ExpAST *) $3);
-    stmt->lval.reset((LValAST *) $1);
+    stmt->exp = (ExpAST *)$3;
+    stmt->lval = (LValAST *)$1;
     $$ = stmt;
   }
   ;
 
 OtherStmt
   : ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::EXP;
     $$ = stmt;
   } | Exp ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::EXP;
-    stmt->exp.reset((ExpAST *)$1);
+    stmt->exp = (ExpAST *)$1;
     $$ = stmt;
   }
   ;
 
 OtherStmt
   : Block {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::BLOCK;
-    stmt->block.reset((BlockAST *)$1);
+    stmt->block = (BlockAST *)$1;
     $$ = stmt;
   }
   ;
 
 OtherStmt
   : WHILE '(' Exp ')' Stmt {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::WHILE;
-    stmt->exp.reset((ExpAST *)$3);
-    stmt->stmt.reset((StmtAST *)$5);
+    stmt->exp = (ExpAST *)$3;
+    stmt->stmt = (StmtAST *)$5;
     $$ = stmt;
   }
   ;
 
 OtherStmt
   : BREAK ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::BREAK;
     $$ = stmt;
   }
@@ -327,7 +304,7 @@ OtherStmt
 
 OtherStmt
   : CONTINUE ';' {
-    auto stmt = new StmtAST();
+    auto stmt = newAST<StmtAST>();
     stmt->tag = StmtAST::CONTINUE;
     $$ = stmt;
   }
@@ -336,20 +313,15 @@ OtherStmt
 ConstDecl
   : CONST BType ConstDefList ';'{
     auto const_decl = (ConstDeclAST *)$3;
-    const_decl->btype = unique_ptr<BTypeAST>((BTypeAST *)$2);
+    const_decl->btype = (BTypeAST *)$2;
     $$ = const_decl;
   }
   ;
 
 ConstDefList
-  : ConstDef ',' ConstDefList {
-    auto const_decl = new ConstDeclAST();
-    auto const_decl_2 = unique_ptr<ConstDeclAST>((ConstDeclAST *)$3);
-    const_decl->const_defs.emplace_back((ConstDefAST *)$1);
-    int n = const_decl_2->const_defs.size();
-    for(int i = 0; i < n; ++i){
-        const_decl->const_defs.emplace_back(const_decl_2->const_defs[i].release());
-    }
+  : ConstDefList ',' ConstDef {
+    auto const_decl = (ConstDeclAST *)$1;
+    const_decl->const_defs.push_back((ConstDefAST *)$3);
     $$ = const_decl;
   }
   ;
@@ -357,8 +329,8 @@ ConstDefList
 
 ConstDefList
   : ConstDef {
-    auto const_decl = new ConstDeclAST();
-    const_decl->const_defs.emplace_back((ConstDefAST *)$1);
+    auto const_decl = newAST<ConstDeclAST>();
+    const_decl->const_defs.push_back((ConstDefAST *)$1);
     $$ = const_decl;
   }
   ;
@@ -366,39 +338,34 @@ ConstDefList
 VarDecl
   : BType VarDefList ';' {
     auto var_decl = (VarDeclAST *)$2;
-    var_decl->btype = unique_ptr<BTypeAST>((BTypeAST *) $1);
+    var_decl->btype = (BTypeAST *)$1;
     $$ = var_decl;
   }
   ;
 
 VarDefList
-  : VarDef ',' VarDefList {
-    auto var_decl = new VarDeclAST();
-    auto var_decl_2 = unique_ptr<VarDeclAST>((VarDeclAST *)$3);
-    var_decl->var_defs.emplace_back((VarDefAST *)$1);
-    int n = var_decl_2->var_defs.size();
-    for(int i = 0; i < n; ++i){
-        var_decl->var_defs.emplace_back(var_decl_2->var_defs[i].release());
-    }
+  : VarDefList ',' VarDef {
+    auto var_decl = (VarDeclAST *)$1;
+    var_decl->var_defs.push_back((VarDefAST *)$3);
     $$ = var_decl;
   }
   ;
 
 VarDefList
   : VarDef {
-    auto var_decl = new VarDeclAST();
-    var_decl->var_defs.emplace_back((VarDefAST *)$1);
+    auto var_decl = newAST<VarDeclAST>();
+    var_decl->var_defs.push_back((VarDefAST *)$1);
     $$ = var_decl;
   }
   ;
 
 BType
   : INT {
-    auto btype = new BTypeAST();
+    auto btype = newAST<BTypeAST>();
     btype->tag = BTypeAST::INT;
     $$ = btype;
   } | VOID {
-    auto btype = new BTypeAST();
+    auto btype = newAST<BTypeAST>();
     btype->tag = BTypeAST::VOID;
     $$ = btype;
   }
@@ -406,47 +373,45 @@ BType
 
 ConstDef
   : IDENT '=' ConstInitVal {
-    auto const_def = new ConstDefAST();
+    auto const_def = newAST<ConstDefAST>();
     const_def->tag = ConstDefAST::VARIABLE;
-    const_def->ident = *unique_ptr<string>($1);
-    const_def->const_init_val = unique_ptr<ConstInitValAST>((ConstInitValAST *)$3);
+    const_def->ident = $1;
+    const_def->const_init_val = (ConstInitValAST *)$3;
     $$ = const_def;
   }
   ;
 ConstDef
   : IDENT ArrayIndexConstExpList '=' ConstInitVal {
-    auto const_def = new ConstDefAST();
-    unique_ptr<ArrayIndexConstExpList> p( (ArrayIndexConstExpList *)$2);
+    auto const_def = newAST<ConstDefAST>();
+    auto p = (ArrayIndexConstExpList *)$2;
     const_def->tag = ConstDefAST::ARRAY;
-    const_def->ident = *unique_ptr<string>($1);
-    for(auto &ce : p->const_exps){
-        const_def->const_exps.emplace_back(ce.release());
-    }
-    const_def->const_init_val = unique_ptr<ConstInitValAST>((ConstInitValAST *)$4);
+    const_def->ident = $1;
+    const_def->const_exps = p->const_exps;
+    const_def->const_init_val = (ConstInitValAST *)$4;
     $$ = const_def;
   }
   ;
 
 ArrayIndexConstExpList
   : '[' ConstExp ']' {
-    auto p = new ArrayIndexConstExpList();
-    p->const_exps.emplace_back((ConstExpAST *)$2);
+    auto p = newAST<ArrayIndexConstExpList>();
+    p->const_exps.push_back((ExpAST *)$2);
     $$ = p;
   } | ArrayIndexConstExpList '[' ConstExp ']' {
     auto p = (ArrayIndexConstExpList *)$1;
-    p->const_exps.emplace_back((ConstExpAST *)$3);
+    p->const_exps.push_back((ExpAST *)$3);
     $$ = p;
   }
   ;
 
 ArrayIndexExpList
   : '[' Exp ']' {
-    auto p = new ArrayIndexExpList();
-    p->exps.emplace_back((ExpAST *)$2);
+    auto p = newAST<ArrayIndexExpList>();
+    p->exps.push_back((ExpAST *)$2);
     $$ = p;
   } | ArrayIndexExpList '[' Exp ']' {
     auto p = (ArrayIndexExpList *)$1;
-    p->exps.emplace_back((ExpAST *)$3);
+    p->exps.push_back((ExpAST *)$3);
     $$ = p;
   }
   ;
@@ -454,46 +419,42 @@ ArrayIndexExpList
 
 VarDef
   : IDENT{
-    auto var_def = new VarDefAST();
+    auto var_def = newAST<VarDefAST>();
     var_def->tag = VarDefAST::VARIABLE;
-    var_def->ident = *unique_ptr<string>($1);
+    var_def->ident = $1;
     $$ = var_def;
   } | IDENT ArrayIndexConstExpList {
-    auto var_def = new VarDefAST();
+    auto var_def = newAST<VarDefAST>();
     var_def->tag = VarDefAST::ARRAY;
-    var_def->ident = *unique_ptr<string>($1);
-    unique_ptr<ArrayIndexConstExpList> p((ArrayIndexConstExpList *)$2);
-    for(auto &ce : p->const_exps){
-        var_def->const_exps.emplace_back(ce.release());
-    }
+    var_def->ident = $1;
+    auto p = (ArrayIndexConstExpList *)$2;
+    var_def->const_exps = p->const_exps;
     $$ = var_def;
   } | IDENT '=' InitVal {
-    auto var_def = new VarDefAST();
+    auto var_def = newAST<VarDefAST>();
     var_def->tag = VarDefAST::VARIABLE;
-    var_def->ident = *unique_ptr<string>($1);
-    var_def->init_val = unique_ptr<InitValAST>((InitValAST *)$3);
+    var_def->ident = $1;
+    var_def->init_val = (InitValAST *)$3;
     $$ = var_def;
   } | IDENT ArrayIndexConstExpList '=' InitVal {
-    auto var_def = new VarDefAST();
+    auto var_def = newAST<VarDefAST>();
     var_def->tag = VarDefAST::ARRAY;
-    var_def->ident = *unique_ptr<string>($1);
-    unique_ptr<ArrayIndexConstExpList> p((ArrayIndexConstExpList *)$2);
-    for(auto &ce : p->const_exps){
-        var_def->const_exps.emplace_back(ce.release());
-    }
-    var_def->init_val = unique_ptr<InitValAST>((InitValAST *)$4);
+    var_def->ident = $1;
+    auto p = (ArrayIndexConstExpList *)$2;
+    var_def->const_exps = p->const_exps;
+    var_def->init_val = (InitValAST *)$4;
     $$ = var_def;
   }
   ;
 
 InitVal
   : Exp{
-    auto init_val = new InitValAST();
+    auto init_val = newAST<InitValAST>();
     init_val->tag = InitValAST::EXP;
-    init_val->exp.reset((ExpAST *)$1);
+    init_val->exp = (ExpAST *)$1;
     $$ = init_val;
   } | '{' '}' {
-    auto init_val = new InitValAST();
+    auto init_val = newAST<InitValAST>();
     init_val->tag = InitValAST::INIT_LIST;
     $$ = init_val;
   } | '{' InitValList '}' {
@@ -502,25 +463,25 @@ InitVal
 
 InitValList
   : InitVal {
-    auto init_val = new InitValAST();
+    auto init_val = newAST<InitValAST>();
     init_val->tag = InitValAST::INIT_LIST;
-    init_val->inits.emplace_back((InitValAST *)$1);
+    init_val->inits.push_back((InitValAST *)$1);
     $$ = init_val;
   } | InitValList ',' InitVal {
     auto init_val = (InitValAST *)$1;
-    init_val->inits.emplace_back((InitValAST *)$3);
+    init_val->inits.push_back((InitValAST *)$3);
     $$ = init_val;
   }
   ;
 
 ConstInitVal
   : ConstExp {
-    auto const_init_val = new ConstInitValAST();
+    auto const_init_val = newAST<ConstInitValAST>();
     const_init_val->tag = ConstInitValAST::CONST_EXP;
-    const_init_val->const_exp = unique_ptr<ConstExpAST>((ConstExpAST *)$1);
+    const_init_val->const_exp = (ExpAST *)$1;
     $$ = const_init_val;
   } |'{' '}' {
-    auto const_init_val = new ConstInitValAST();
+    auto const_init_val = newAST<ConstInitValAST>();
     const_init_val->tag = ConstInitValAST::CONST_INIT_LIST;
     $$ = const_init_val;
   } | '{' ConstInitValList '}' {
@@ -530,13 +491,13 @@ ConstInitVal
 
 ConstInitValList
   : ConstInitVal {
-    auto init_val = new ConstInitValAST();
+    auto init_val = newAST<ConstInitValAST>();
     init_val->tag = ConstInitValAST::CONST_INIT_LIST;
-    init_val->inits.emplace_back((ConstInitValAST *)$1);
+    init_val->inits.push_back((ConstInitValAST *)$1);
     $$ = init_val;
   } | ConstInitValList ',' ConstInitVal {
     auto init_val = (ConstInitValAST *)$1;
-    init_val->inits.emplace_back((ConstInitValAST *)$3);
+    init_val->inits.push_back((ConstInitValAST *)$3);
     $$ = init_val;
   }
   ;
@@ -544,62 +505,46 @@ ConstInitValList
 
 LVal
   : IDENT {
-    auto lval = new LValAST();
+    auto lval = newAST<LValAST>();
     lval->tag = LValAST::VARIABLE;
-    lval->ident = *unique_ptr<string>($1);
+    lval->ident = $1;
     $$ = lval;
   } | IDENT ArrayIndexExpList {
-    auto lval = new LValAST();
-    unique_ptr<ArrayIndexExpList> p((ArrayIndexExpList *)$2);
+    auto lval = newAST<LValAST>();
+    auto p = (ArrayIndexExpList *)$2;
     lval->tag = LValAST::ARRAY;
-    lval->ident = *unique_ptr<string>($1);
-    for(auto &e : p->exps){
-        lval->exps.emplace_back(e.release());
-    }
+    lval->ident = $1;
+    lval->exps = p->exps;
     $$ = lval;
   }
   ;
 
+// 表达式的各级只用于表示优先级，都归约为同一种 ExpAST 结点
 ConstExp
   : Exp {
-    auto const_exp = new ConstExpAST();
-    const_exp->exp = unique_ptr<ExpAST>((ExpAST *)$1);
-    $$ = const_exp;
+    $$ = $1;
   }
   ;
 
 Exp
   : LOrExp {
-    auto exp = new ExpAST();
-    exp->l_or_exp = unique_ptr<LOrExpAST>((LOrExpAST *)$1);
-    $$ = exp;
+    $$ = $1;
   }
   ;
 
 PrimaryExp
   : '(' Exp ')' {
-    auto primary_exp = new PrimaryExpAST();
-    primary_exp->tag = PrimaryExpAST::PARENTHESES;
-    primary_exp->exp =  unique_ptr<ExpAST>((ExpAST *)$2);
-    $$ = primary_exp;
-  } 
-  ;
-
-PrimaryExp 
-  : Number {
-    auto primary_exp = new PrimaryExpAST();
-    primary_exp->tag = PrimaryExpAST::NUMBER;
-    primary_exp->number = $1;
-    $$ = primary_exp;
-  }
-  ;
-
-PrimaryExp 
-  : LVal {
-    auto primary_exp = new PrimaryExpAST();
-    primary_exp->tag = PrimaryExpAST::LVAL;
-    primary_exp->lval =  unique_ptr<LValAST>((LValAST *)$1);
-    $$ = primary_exp;
+    $$ = $2;
+  } | Number {
+    auto exp = newAST<ExpAST>();
+    exp->tag = ExpAST::NUMBER;
+    exp->number = $1;
+    $$ = exp;
+  } | LVal {
+    auto exp = newAST<ExpAST>();
+    exp->tag = ExpAST::LVAL;
+    exp->lval = (LValAST *)$1;
+    $$ = exp;
   }
   ;
 
@@ -611,224 +556,96 @@ Number
 
 UnaryExp
   : PrimaryExp {
-    auto unary_exp = new UnaryExpAST();
-    unary_exp->tag = UnaryExpAST::PRIMARY_EXP;
-    unary_exp->primary_exp = unique_ptr<PrimaryExpAST>((PrimaryExpAST *)$1);
-    $$ = unary_exp;
-  }
-  ;
-
-UnaryExp
-  : UnaryOp UnaryExp{
-    auto unary_exp = new UnaryExpAST();
-    unary_exp->tag = UnaryExpAST::OP_UNITARY_EXP;
-    unary_exp->unary_op = $1;
-    unary_exp->unary_exp = unique_ptr<UnaryExpAST>((UnaryExpAST *)$2);
-    $$ = unary_exp;
-  }
-  ;
-
-UnaryExp
-  : IDENT '(' ')' {
-    auto unary_exp = new UnaryExpAST();
-    unary_exp->tag = UnaryExpAST::FUNC_CALL;
-    unary_exp->ident = *unique_ptr<string>($1);
-    $$ = unary_exp;
+    $$ = $1;
+  } | UnaryOp UnaryExp {
+    if($1 == '+'){
+      $$ = $2;
+    } else {
+      auto exp = newAST<ExpAST>();
+      exp->tag = ExpAST::UNARY;
+      exp->op = $1 == '-' ? Value::SUB : Value::EQ;
+      exp->lhs = (ExpAST *)$2;
+      $$ = exp;
+    }
+  } | IDENT '(' ')' {
+    auto exp = newAST<ExpAST>();
+    exp->tag = ExpAST::CALL;
+    exp->ident = $1;
+    $$ = exp;
   } | IDENT '(' FuncRParams ')' {
-    auto unary_exp = new UnaryExpAST();
-    unary_exp->tag = UnaryExpAST::FUNC_CALL;
-    unary_exp->ident = *unique_ptr<string>($1);
-    unary_exp->func_params.reset((FuncRParamsAST *)$3);
-    $$ = unary_exp;
-  }
-  ;
-
-
-
-MulExp
-  : UnaryExp{
-    auto mul_exp = new MulExpAST();
-    mul_exp->tag = MulExpAST::UNARY_EXP;
-    mul_exp->unary_exp = unique_ptr<UnaryExpAST>((UnaryExpAST *)$1);
-    $$ = mul_exp;
+    auto exp = newAST<ExpAST>();
+    exp->tag = ExpAST::CALL;
+    exp->ident = $1;
+    exp->func_params = (FuncRParamsAST *)$3;
+    $$ = exp;
   }
   ;
 
 MulExp
-  : MulExp '*' UnaryExp{
-    auto mul_exp = new MulExpAST();
-    mul_exp->tag = MulExpAST::OP_MUL_EXP;
-    mul_exp->mul_exp_1 = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    mul_exp->unary_exp_2 = unique_ptr<UnaryExpAST>((UnaryExpAST *)$3);
-    mul_exp->mul_op = '*';
-    $$ = mul_exp;
+  : UnaryExp {
+    $$ = $1;
+  } | MulExp '*' UnaryExp {
+    $$ = binaryExp(Value::MUL, $1, $3);
+  } | MulExp '/' UnaryExp {
+    $$ = binaryExp(Value::DIV, $1, $3);
+  } | MulExp '%' UnaryExp {
+    $$ = binaryExp(Value::MOD, $1, $3);
   }
   ;
 
-MulExp
-  : MulExp '/' UnaryExp{
-    auto mul_exp = new MulExpAST();
-    mul_exp->tag = MulExpAST::OP_MUL_EXP;
-    mul_exp->mul_exp_1 = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    mul_exp->unary_exp_2 = unique_ptr<UnaryExpAST>((UnaryExpAST *)$3);
-    mul_exp->mul_op = '/';
-    $$ = mul_exp;
-  }
-  ;
-MulExp
-  : MulExp '%' UnaryExp{
-    auto mul_exp = new MulExpAST();
-    mul_exp->tag = MulExpAST::OP_MUL_EXP;
-    mul_exp->mul_exp_1 = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    mul_exp->unary_exp_2 = unique_ptr<UnaryExpAST>((UnaryExpAST *)$3);
-    mul_exp->mul_op = '%';
-    $$ = mul_exp;
-  }
-  ;
-AddExp 
+AddExp
   : MulExp {
-    auto add_exp = new AddExpAST();
-    add_exp->tag = AddExpAST::MUL_EXP;
-    add_exp->mul_exp = unique_ptr<MulExpAST>((MulExpAST *)$1);
-    $$ = add_exp;
-  }
-  ;
-
-AddExp 
-  : AddExp '+' MulExp {
-    auto add_exp = new AddExpAST();
-    add_exp->tag = AddExpAST::OP_ADD_EXP;
-    add_exp->add_exp_1 = unique_ptr<AddExpAST>((AddExpAST *)$1);
-    add_exp->mul_exp_2 = unique_ptr<MulExpAST>((MulExpAST *)$3);
-    add_exp->add_op = '+';
-    $$ = add_exp;
-  }
-  ;
-AddExp 
-  : AddExp '-' MulExp {
-    auto add_exp = new AddExpAST();
-    add_exp->tag = AddExpAST::OP_ADD_EXP;
-    add_exp->add_exp_1 = unique_ptr<AddExpAST>((AddExpAST *)$1);
-    add_exp->mul_exp_2 = unique_ptr<MulExpAST>((MulExpAST *)$3);
-    add_exp->add_op = '-';
-    $$ = add_exp;
-  }
-  ;
-
-RelExp 
-  : AddExp{
-    auto rel_exp = new RelExpAST();
-    rel_exp->tag = RelExpAST::ADD_EXP;
-    rel_exp->add_exp = unique_ptr<AddExpAST>((AddExpAST *)$1);
-    $$ = rel_exp;
+    $$ = $1;
+  } | AddExp '+' MulExp {
+    $$ = binaryExp(Value::ADD, $1, $3);
+  } | AddExp '-' MulExp {
+    $$ = binaryExp(Value::SUB, $1, $3);
   }
   ;
 
-RelExp 
-  : RelExp '<' AddExp{
-    auto rel_exp = new RelExpAST();
-    rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
-    rel_exp->rel_op[0] = '<';
-    rel_exp->rel_op[1] = 0;
-    $$ = rel_exp;
+RelExp
+  : AddExp {
+    $$ = $1;
+  } | RelExp '<' AddExp {
+    $$ = binaryExp(Value::LT, $1, $3);
+  } | RelExp '>' AddExp {
+    $$ = binaryExp(Value::GT, $1, $3);
+  } | RelExp LESS_EQ AddExp {
+    $$ = binaryExp(Value::LE, $1, $3);
+  } | RelExp GREAT_EQ AddExp {
+    $$ = binaryExp(Value::GE, $1, $3);
   }
   ;
 
-RelExp 
-  : RelExp '>' AddExp{
-    auto rel_exp = new RelExpAST();
-    rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
-    rel_exp->rel_op[0] = '>';
-    rel_exp->rel_op[1] = 0;
-    $$ = rel_exp;
-  }
-  ;
-RelExp 
-  : RelExp LESS_EQ AddExp{
-    auto rel_exp = new RelExpAST();
-    rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
-    rel_exp->rel_op[0] = '<';
-    rel_exp->rel_op[1] = '=';
-    $$ = rel_exp;
-  }
-  ;
-RelExp 
-  : RelExp GREAT_EQ AddExp{
-    auto rel_exp = new RelExpAST();
-    rel_exp->tag = RelExpAST::OP_REL_EXP;
-    rel_exp->rel_exp_1 = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    rel_exp->add_exp_2 = unique_ptr<AddExpAST>((AddExpAST *)$3);
-    rel_exp->rel_op[0] = '>';
-    rel_exp->rel_op[1] = '=';
-    $$ = rel_exp;
-  }
-  ;
-EqExp 
-  : RelExp{
-    auto eq_exp = new EqExpAST();
-    eq_exp->tag = EqExpAST::REL_EXP;
-    eq_exp->rel_exp = unique_ptr<RelExpAST>((RelExpAST *)$1);
-    $$ = eq_exp;
+EqExp
+  : RelExp {
+    $$ = $1;
+  } | EqExp EQUAL RelExp {
+    $$ = binaryExp(Value::EQ, $1, $3);
+  } | EqExp NOT_EQUAL RelExp {
+    $$ = binaryExp(Value::NE, $1, $3);
   }
   ;
 
-EqExp 
-  : EqExp EQUAL RelExp{
-    auto eq_exp = new EqExpAST();
-    eq_exp->tag = EqExpAST::OP_EQ_EXP;
-    eq_exp->eq_exp_1 = unique_ptr<EqExpAST>((EqExpAST *)$1);
-    eq_exp->rel_exp_2 = unique_ptr<RelExpAST>((RelExpAST *)$3);
-    eq_exp->eq_op = '=';
-    $$ = eq_exp;
-  }
-  ;
-EqExp 
-  : EqExp NOT_EQUAL RelExp{
-    auto eq_exp = new EqExpAST();
-    eq_exp->tag = EqExpAST::OP_EQ_EXP;
-    eq_exp->eq_exp_1 = unique_ptr<EqExpAST>((EqExpAST *)$1);
-    eq_exp->rel_exp_2 = unique_ptr<RelExpAST>((RelExpAST *)$3);
-    eq_exp->eq_op = '!';
-    $$ = eq_exp;
-  }
-  ;
 LAndExp
   : EqExp {
-    auto l_and_exp = new LAndExpAST();
-    l_and_exp->tag = LAndExpAST::EQ_EXP;
-    l_and_exp->eq_exp = unique_ptr<EqExpAST>((EqExpAST *)$1);
-    $$ = l_and_exp;
-  }
-LAndExp
-  : LAndExp AND EqExp{
-    auto l_and_exp = new LAndExpAST();
-    l_and_exp->tag = LAndExpAST::OP_L_AND_EXP;
-    l_and_exp->l_and_exp_1 = unique_ptr<LAndExpAST>((LAndExpAST *)$1);
-    l_and_exp->eq_exp_2 = unique_ptr<EqExpAST>((EqExpAST *)$3);
-    $$ = l_and_exp;
+    $$ = $1;
+  } | LAndExp AND EqExp {
+    auto exp = (ExpAST *)binaryExp(Value::AND, $1, $3);
+    exp->tag = ExpAST::AND;
+    $$ = exp;
   }
+  ;
 
 LOrExp
   : LAndExp {
-    auto l_or_exp = new LOrExpAST();
-    l_or_exp->tag = LOrExpAST::L_AND_EXP;
-    l_or_exp->l_and_exp = unique_ptr<LAndExpAST>((LAndExpAST *)$1);
-    $$ = l_or_exp;
-  }
-LOrExp
-  : LOrExp OR LAndExp {
-    auto l_or_exp = new LOrExpAST();
-    l_or_exp->tag = LOrExpAST::OP_L_OR_EXP;
-    l_or_exp->l_or_exp_1 = unique_ptr<LOrExpAST>((LOrExpAST *)$1);
-    l_or_exp->l_and_exp_2 = unique_ptr<LAndExpAST>((LAndExpAST *)$3);
-    $$ = l_or_exp;
+    $$ = $1;
+  } | LOrExp OR LAndExp {
+    auto exp = (ExpAST *)binaryExp(Value::OR, $1, $3);
+    exp->tag = ExpAST::OR;
+    $$ = exp;
   }
+  ;
 
 UnaryOp 
   : '+' {
@@ -849,17 +666,12 @@ UnaryOp
 
 FuncRParams
   : Exp {
-    auto params = new FuncRParamsAST();
-    params->exps.emplace_back((ExpAST *)$1);
+    auto params = newAST<FuncRParamsAST>();
+    params->exps.push_back((ExpAST *)$1);
     $$ = params;
-  } | Exp ',' FuncRParams {
-    auto params = new FuncRParamsAST();
-    params->exps.emplace_back((ExpAST *)$1);
-    auto p2 = unique_ptr<FuncRParamsAST>((FuncRParamsAST *)$3);
-    int n = p2->exps.size();
-    for(int i = 0; i < n; ++i){
-        params->exps.emplace_back(p2->exps[i].release());
-    }
+  } | FuncRParams ',' Exp {
+    auto params = (FuncRParamsAST *)$1;
+    params->exps.push_back((ExpAST *)$3);
     $$ = params;
   }
   ;
@@ -868,6 +680,6 @@ FuncRParams
 
 // 定义错误处理函数, 其中第二个参数是错误信息
 // parser 如果发生错误 (例如输入的程序出现了语法错误), 就会调用这个函数
-void yyerror(unique_ptr<BaseAST> &ast, const char *s) {
+void yyerror(unique_ptr<CompUnitAST> &ast, const char *s) {
   cerr << "error: " << s << endl;
 }
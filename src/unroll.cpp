@@ -0,0 +1,348 @@
+#include "pass.h"
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+using namespace std;
+
+/**
+ * 循环展开。处理只有一个基本块的计数循环（while旋转并合并基本块后，没有分支的循环体就是这样）:
+ *   B(.., p, ..): ...; x = add p, s; c = lt x, n; br c, B(.., x, ..), X(...)
+ * 归纳变量p每次迭代加常量s，与循环不变量n比较。
+ * 初值和n都是常量、展开后的指令数不超过FULL_UNROLL_SIZE时完全展开，不再有循环；
+ * 否则展开UNROLL_FACTOR次：进入展开后的循环前和每轮末尾检查剩下的次数是否还够一轮，
+ * 不够时交给原来的循环做完剩下的迭代。
+*/
+
+static const int FULL_UNROLL_SIZE = 128;    // 完全展开后最多的指令数
+static const int UNROLL_FACTOR = 4;
+static const int UNROLL_SIZE = 128;         // 部分展开后循环体最多的指令数
+
+namespace {
+// 一个可以展开的循环
+struct CountedLoop{
+    BasicBlock *body, *exit, *pre;
+    Value *br;              // body末尾的branch
+    int k_back;             // br的第k_back个目标是body
+    Value *pre_term;        // pre末尾跳到body的指令
+    int k_pre;
+    Value *cond;            // 不被展开的比较
+    int iv;                 // 归纳变量是body的第iv个参数
+    Value *bound;           // 循环不变量n
+    Value::OP op;           // 继续循环的条件: 归纳变量 op n
+    int step;
+    vector<Value *> insts;  // 要复制的指令，不含cond和br
+};
+}
+
+static Value::OP swapCmp(Value::OP op){
+    switch(op){
+        case Value::LT: return Value::GT;
+        case Value::GT: return Value::LT;
+        case Value::LE: return Value::GE;
+        case Value::GE: return Value::LE;
+        default: return op;
+    }
+}
+
+static Value::OP invertCmp(Value::OP op){
+    switch(op){
+        case Value::LT: return Value::GE;
+        case Value::GE: return Value::LT;
+        case Value::GT: return Value::LE;
+        case Value::LE: return Value::GT;
+        case Value::EQ: return Value::NE;
+        default: return Value::EQ;
+    }
+}
+
+// 在基本块末尾追加一条新指令
+static Value *append(BasicBlock *bb, Value::TAG tag, IRType *ty){
+    Value *v = bb->func->newValue(tag, ty);
+    v->bb = bb;
+    bb->insts.push_back(v);
+    return v;
+}
+
+static Value *appendBinary(BasicBlock *bb, Value::OP op, Value *l, Value *r){
+    Value *v = append(bb, Value::BINARY, IRType::getInt32());
+    v->op = op;
+    v->addOperand(l);
+    v->addOperand(r);
+    return v;
+}
+
+static Value *appendBranch(BasicBlock *bb, Value *cond, BasicBlock *t, const vector<Value *> &t_args,
+                           BasicBlock *f, const vector<Value *> &f_args){
+    Value *v = append(bb, Value::BRANCH, IRType::getUnit());
+    v->addOperand(cond);
+    v->target[0] = t;
+    v->target[1] = f;
+    for(auto a : t_args) v->addArg(0, a);
+    for(auto a : f_args) v->addArg(1, a);
+    return v;
+}
+
+// 把循环体复制一遍到to的末尾。vmap中是循环体参数在这一遍的值，复制出的指令也记入vmap
+static void cloneBody(const CountedLoop &L, BasicBlock *to, unordered_map<Value *, Value *> &vmap){
+    for(auto v : L.insts){
+        Value *c = to->func->cloneValue(v, vmap);
+        c->bb = to;
+        to->insts.push_back(c);
+        vmap[v] = c;
+    }
+}
+
+// 下一遍的参数: 回边上的实参在这一遍的值
+static void nextIteration(const CountedLoop &L, unordered_map<Value *, Value *> &vmap){
+    vector<Value *> next;
+    for(auto a : L.br->getArgs(L.k_back))
+        next.push_back(mapValue(vmap, a));
+    vmap.clear();
+    for(size_t i = 0; i < next.size(); ++i)
+        vmap[L.body->params[i]] = next[i];
+}
+
+static bool definedIn(Value *v, BasicBlock *bb){
+    return !v->isConst() && v->bb == bb;
+}
+
+// 识别计数循环
+static bool analyze(BasicBlock *body, CountedLoop &L){
+    Value *br = body->getTerminator();
+    if(br == nullptr || br->tag != Value::BRANCH || (br->target[0] == body) == (br->target[1] == body))
+        return false;
+    L.body = body;
+    L.br = br;
+    L.k_back = br->target[0] == body ? 0 : 1;
+    L.exit = br->target[L.k_back ^ 1];
+    if(body->preds.size() != 2) return false;
+    L.pre = body->preds[0] == body ? body->preds[1] : body->preds[0];
+    L.pre_term = L.pre->getTerminator();
+    if(L.pre_term->tag == Value::BRANCH && L.pre_term->target[0] == L.pre_term->target[1])
+        return false;
+    L.k_pre = L.pre_term->target[0] == body ? 0 : 1;
+
+    // 循环中的值只在循环中使用，离开循环的值都通过出口的参数传递
+    for(auto p : body->params){
+        for(auto u : p->users)
+            if(u->bb != body) return false;
+    }
+    L.insts.clear();
+    for(auto v : body->insts){
+        if(v->tag == Value::ALLOC) return false;
+        for(auto u : v->users)
+            if(u->bb != body) return false;
+    }
+
+    Value *c = br->ops[0];
+    if(c->tag != Value::BINARY || !definedIn(c, body) || c->users.size() != 1)
+        return false;
+    if(c->op != Value::LT && c->op != Value::LE && c->op != Value::GT && c->op != Value::GE)
+        return false;
+    L.cond = c;
+    L.op = L.k_back == 0 ? c->op : invertCmp(c->op);
+    vector<Value *> back = br->getArgs(L.k_back);
+    for(int j = 0; j < 2; ++j){
+        Value *x = c->ops[j], *n = c->ops[j ^ 1];
+        if(definedIn(n, body) || !definedIn(x, body) || x->tag != Value::BINARY)
+            continue;
+        if(x->op != Value::ADD && x->op != Value::SUB)
+            continue;
+        // x = p + s 或 p - s，且回边上传给p的就是x
+        int pi = -1;
+        Value *s = nullptr;
+        for(int side = 0; side < 2 && pi < 0; ++side){
+            Value *p = x->ops[side];
+            if(p->tag != Value::BLOCK_ARG || p->bb != body || x->ops[side ^ 1]->tag != Value::INTEGER)
+                continue;
+            if(x->op == Value::SUB && side == 1)
+                continue;
+            if(back[p->value] != x)
+                continue;
+            pi = p->value;
+            s = x->ops[side ^ 1];
+        }
+        if(pi < 0) continue;
+        L.iv = pi;
+        L.step = x->op == Value::ADD ? s->value : -s->value;
+        L.bound = n;
+        if(j == 1) L.op = swapCmp(L.op);
+        bool up = L.op == Value::LT || L.op == Value::LE;
+        if(L.step == 0 || abs(L.step) > (1 << 16) || (L.step > 0) != up)
+            return false;
+        for(auto v : body->insts){
+            if(v != c && v != br)
+                L.insts.push_back(v);
+        }
+        return true;
+    }
+    return false;
+}
+
+// 循环以初值a开始时的迭代次数，超过limit时返回-1
+static int64_t tripCount(const CountedLoop &L, int64_t a, int64_t n, int64_t limit){
+    int64_t t = 1;
+    for(int64_t v = a + L.step; ; v += L.step, ++t){
+        if(v < INT32_MIN || v > INT32_MAX || t > limit) return -1;
+        bool go = L.op == Value::LT ? v < n : L.op == Value::LE ? v <= n : L.op == Value::GT ? v > n : v >= n;
+        if(!go) return t;
+    }
+}
+
+// 完全展开成t遍，循环体的参数换成初值，最后直接跳到出口
+static void fullUnroll(const CountedLoop &L, int64_t t){
+    BasicBlock *body = L.body;
+    unordered_map<Value *, Value *> vmap;
+    for(auto p : body->params)
+        vmap[p] = p;
+    for(auto v : L.insts)
+        vmap[v] = v;
+    for(int64_t k = 1; k < t; ++k){
+        nextIteration(L, vmap);
+        cloneBody(L, body, vmap);
+    }
+    vector<Value *> exit_args;
+    for(auto a : L.br->getArgs(L.k_back ^ 1))
+        exit_args.push_back(mapValue(vmap, a));
+
+    body->insts.remove(L.br);
+    body->insts.remove(L.cond);
+    L.br->dropOperands();
+    L.cond->dropOperands();
+    Value *j = append(body, Value::JUMP, IRType::getUnit());
+    j->target[0] = L.exit;
+    for(auto a : exit_args)
+        j->addArg(0, a);
+
+    vector<Value *> init = L.pre_term->getArgs(L.k_pre);
+    for(size_t i = body->params.size(); i-- > 0; ){
+        body->params[i]->replaceAllUsesWith(init[i]);
+        L.pre_term->removeArg(L.k_pre, i);
+    }
+    body->params.clear();
+    body->preds = {L.pre};
+}
+
+static BasicBlock *newBlockLike(BasicBlock *body, const string &suffix){
+    Function *func = body->func;
+    BasicBlock *bb = func->newBasicBlock(body->name + suffix);
+    for(auto p : body->params){
+        Value *q = func->newValue(Value::BLOCK_ARG, p->ty);
+        q->bb = bb;
+        q->value = bb->params.size();
+        bb->params.push_back(q);
+    }
+    func->bbs.push_back(bb);
+    return bb;
+}
+
+/**
+ * 部分展开。循环体至少执行一遍，之后每轮末尾判断 p op n。pre先跳到guard，剩下的次数够一轮时进入展开的循环unrolled，
+ * 否则直接进入原来的循环；unrolled每轮末尾同样检查，不够时到rest，rest补上原来每轮末尾对 p op n 的判断，
+ * 成立则进入原来的循环做完剩下的迭代，否则离开循环。
+ * 向上计数时"还够一轮"即 n - p > (U-1)*s（<=时为 >= ）。guard处另外要求 p op n，此时 n - p 为正，溢出也只会得到负数，
+ * 不会误判成够一轮；unrolled末尾的p比上一次检查时只多走了U步，与n相差很小，不会溢出。
+*/
+static bool partialUnroll(const CountedLoop &L, int factor){
+    BasicBlock *body = L.body;
+    vector<Value *> back = L.br->getArgs(L.k_back);
+    vector<Value *> exits = L.br->getArgs(L.k_back ^ 1);
+    // rest只知道参数的值，出口的实参须是循环不变量或者回边上的实参
+    vector<int> exit_from(exits.size(), -1);
+    for(size_t i = 0; i < exits.size(); ++i){
+        if(!definedIn(exits[i], body)) continue;
+        for(size_t j = 0; j < back.size() && exit_from[i] < 0; ++j){
+            if(back[j] == exits[i]) exit_from[i] = j;
+        }
+        if(exit_from[i] < 0) return false;
+    }
+    bool up = L.step > 0;
+    int room = (factor - 1) * abs(L.step);
+    if(L.op == Value::LE || L.op == Value::GE) --room;
+    auto enough = [&](BasicBlock *bb, Value *iv){
+        Value *d = up ? appendBinary(bb, Value::SUB, L.bound, iv) : appendBinary(bb, Value::SUB, iv, L.bound);
+        return appendBinary(bb, Value::GT, d, body->func->program->getInt(room));
+    };
+
+    // 初值和n都是常量时在编译时判断，够一轮的直接进入unrolled，否则不展开
+    Value *init = L.pre_term->ops[L.pre_term->argBegin(L.k_pre) + L.iv];
+    bool known = init->tag == Value::INTEGER && L.bound->tag == Value::INTEGER;
+    if(known){
+        int a = init->value, n = L.bound->value;
+        int d = up ? foldBinary(Value::SUB, n, a) : foldBinary(Value::SUB, a, n);
+        if(!foldBinary(L.op, a, n) || !foldBinary(Value::GT, d, room))
+            return false;
+    }
+
+    BasicBlock *unrolled = newBlockLike(body, "_u");
+    BasicBlock *rest = newBlockLike(body, "_rg");
+    if(known){
+        L.pre_term->target[L.k_pre] = unrolled;
+        unrolled->preds = {L.pre, unrolled};
+        body->preds = {body, rest};
+    } else {
+        BasicBlock *guard = newBlockLike(body, "_ug");
+        L.pre_term->target[L.k_pre] = guard;
+        guard->preds = {L.pre};
+        unrolled->preds = {guard, unrolled};
+        body->preds = {guard, body, rest};
+        Value *p = guard->params[L.iv];
+        Value *go = appendBinary(guard, Value::AND, appendBinary(guard, L.op, p, L.bound), enough(guard, p));
+        appendBranch(guard, go, unrolled, guard->params, body, guard->params);
+    }
+
+    unordered_map<Value *, Value *> vmap;
+    for(size_t i = 0; i < body->params.size(); ++i)
+        vmap[body->params[i]] = unrolled->params[i];
+    for(int k = 0; k < factor; ++k){
+        if(k > 0) nextIteration(L, vmap);
+        cloneBody(L, unrolled, vmap);
+    }
+    vector<Value *> next;
+    for(auto a : back)
+        next.push_back(mapValue(vmap, a));
+    appendBranch(unrolled, enough(unrolled, next[L.iv]), unrolled, next, rest, next);
+
+    vector<Value *> rest_exits;
+    for(size_t i = 0; i < exits.size(); ++i)
+        rest_exits.push_back(exit_from[i] < 0 ? exits[i] : rest->params[exit_from[i]]);
+    Value *c = appendBinary(rest, L.op, rest->params[L.iv], L.bound);
+    appendBranch(rest, c, body, rest->params, L.exit, rest_exits);
+    rest->preds = {unrolled};
+    L.exit->preds.push_back(rest);
+    return true;
+}
+
+int unrollLoops(Function *func){
+    func->mergeBlocks();
+    vector<BasicBlock *> loops;
+    for(auto bb : func->bbs){
+        for(auto p : bb->preds){
+            if(p == bb) loops.push_back(bb);
+        }
+    }
+    // 展开时只更新受影响的基本块的preds，不重新计算整个CFG
+    bool changed = false;
+    int full = 0;
+    for(auto bb : loops){
+        CountedLoop L;
+        if(!analyze(bb, L)) continue;
+        int size = L.insts.size() + 1;
+        Value *init = L.pre_term->ops[L.pre_term->argBegin(L.k_pre) + L.iv];
+        if(init->tag == Value::INTEGER && L.bound->tag == Value::INTEGER){
+            int64_t t = tripCount(L, init->value, L.bound->value, FULL_UNROLL_SIZE / size);
+            if(t > 0){
+                fullUnroll(L, t);
+                changed = true;
+                ++full;
+                continue;
+            }
+        }
+        int factor = min(UNROLL_FACTOR, UNROLL_SIZE / size);
+        if(factor >= 2 && partialUnroll(L, factor))
+            changed = true;
+    }
+    if(changed)
+        func->mergeBlocks();
+    return full;
+}
@@ -1,219 +1,344 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <new>
+#include <utility>
+#include <type_traits>
 #include <unordered_map>
 #include <set>
 #include <vector>
 #include <stack>
 
-class KoopaString{
+class BasicBlock;
+
+/**
+ * 输出缓冲。内容直接格式化到一块固定大小的缓冲区中，写满就整块写到文件描述符，
+ * 缓冲区反复使用，输出过程中没有逐行的堆分配。默认输出到标准输出。
+*/
+class Emitter{
 private:
-    std::string koopa_str;
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+    char *buf;
+    size_t len;
+    int fd;
+    std::string *capture;   // 非空时输出暂存到这个字符串中
 public:
-    void append(const std::string &s){
-        koopa_str += s;
-    }
-
-    void binary(const std::string &op, const std::string &rd, const std::string &s1, const std::string &s2){
-        koopa_str += "  " + rd + " = " + op + " " + s1 + ", " + s2 + "\n";
-    }
-
-    void label(const std::string &s){
-        koopa_str += s + ":\n";
-    }
-
-    void ret(const std::string &name){
-        koopa_str +="  ret " + name + "\n";
-    }
-
-    void alloc(const std::string &name){
-        koopa_str += "  " + name + " = alloc i32\n";
-    }
-
-    void alloc(const std::string &name, const std::string &type_str){
-        koopa_str += "  " + name + " = alloc " + type_str + "\n";
+    Emitter(): buf(new char[CHUNK_SIZE]), len(0), fd(1), capture(nullptr){}
+    Emitter(const Emitter &) = delete;
+    Emitter &operator=(const Emitter &) = delete;
+    ~Emitter(){
+        flush();
+        delete[] buf;
     }
 
-    void globalAllocINT(const std::string &name, const std::string &init = "zeroinit"){
-        koopa_str += "global " + name + " = alloc i32, " + init + "\n";
+    void setOutput(int _fd){
+        flush();
+        fd = _fd;
     }
 
-    void globalAllocArray(const std::string &name, const std::string &array_type, const std::string &init){
-        koopa_str += "global " + name + " = alloc " + array_type + ", " + init + "\n";
+    // 之后的输出暂存到s中，直到endCapture
+    void beginCapture(std::string *s){
+        capture = s;
     }
 
-    void load(const std::string & to, const std::string &from){
-        koopa_str += "  " + to + " = load " + from + '\n';
+    void endCapture(){
+        capture = nullptr;
     }
 
-    void store(const std::string &from, const std::string &to){
-        koopa_str += "  store " + from + ", " + to + '\n';
-    }
-
-    void br(const std::string &v, const std::string &then_s, const std::string &else_s){
-        koopa_str += "  br " + v + ", " + then_s + ", " + else_s + '\n';
-    }
-    
-    void jump(const std::string &label){
-        koopa_str += "  jump " + label + '\n';
-    }
-
-    void call(const std::string &to, const std::string &func,const std::vector<std::string>& params){
-        if(to.length()){
-            koopa_str += "  " + to + " = ";
-        }else{
-            koopa_str += "  ";
-        }
-        koopa_str += "call " + func +"(";
-        if(params.size()){
-            int n = params.size();
-            koopa_str += params[0];
-            for(int i = 1; i < n; ++i){
-                koopa_str += ", " + params[i];
+    void flush(){
+        size_t done = 0;
+        while(done < len){
+            ssize_t n = ::write(fd, buf + done, len - done);
+            if(n < 0){
+                if(errno == EINTR) continue;
+                break;
             }
+            done += n;
         }
-        koopa_str += ")\n";
-    }
-
-    void getelemptr(const std::string& to, const std::string &from, const int i){
-        koopa_str += "  " + to + " = getelemptr " + from + ", " + std::to_string(i) + "\n";
-    }
-
-    void getelemptr(const std::string& to, const std::string &from, const std::string& i){
-        koopa_str += "  " + to + " = getelemptr " + from + ", " + i + "\n";
-    }
-
-    void getptr(const std::string& to, const std::string &from, const std::string& i){
-        koopa_str += "  " + to + " = getptr " + from + ", " + i + "\n";
+        len = 0;
     }
 
-    void declLibFunc(){
-        this->append("decl @getint(): i32\n");
-        this->append("decl @getch(): i32\n");
-        this->append("decl @getarray(*i32): i32\n");
-        this->append("decl @putint(i32)\n");
-        this->append("decl @putch(i32)\n");
-        this->append("decl @putarray(i32, *i32)\n");
-        this->append("decl @starttime()\n");
-        this->append("decl @stoptime()\n");
-        this->append("\n");
+    void append(char c){
+        if(capture){
+            capture->push_back(c);
+            return;
+        }
+        if(len == CHUNK_SIZE) flush();
+        buf[len++] = c;
     }
 
-    std::string getArrayType(const std::vector<int> &w){
-        // int a[w0][w1]...[wn-1]
-        std::string ans = "i32";
-        for(int i = w.size() - 1; i >= 0; --i){
-            ans = "[" + ans + ", " + std::to_string(w[i]) + "]";
+    void append(std::string_view s){
+        if(capture){
+            capture->append(s);
+            return;
+        }
+        while(!s.empty()){
+            if(len == CHUNK_SIZE) flush();
+            size_t n = std::min(s.size(), CHUNK_SIZE - len);
+            memcpy(buf + len, s.data(), n);
+            len += n;
+            s.remove_prefix(n);
         }
-        return ans;
     }
 
-    // 数组内容在ptr所指的内存区域，数组类型由len描述. ptr[i]为常量，或者是KoopaIR中的名字
-    std::string getInitList(std::string *ptr, const std::vector<int> &len){
-        std::string ret = "{";
-        if(len.size() == 1){
-            int n = len[0];
-            ret += ptr[0];
-            for(int i = 1; i < n; ++i){
-                ret += ", " + ptr[i];
-            }
-        } else {
-            int n = len[0], width = 1;
-            std::vector<int> sublen(len.begin() + 1, len.end());
-            for(auto iter = len.end() - 1; iter != len.begin(); --iter)
-                width *= *iter;
-            ret += getInitList(ptr, sublen);
-            for(int i = 1; i < n; ++i){
-                ret += ", " + getInitList(ptr + width * i, sublen);
-            }
+    void appendInt(int i){
+        char tmp[12];
+        int n = 0;
+        unsigned u = i < 0 ? 0u - (unsigned)i : (unsigned)i;
+        do{
+            tmp[n++] = '0' + u % 10;
+            u /= 10;
+        }while(u);
+        if(i < 0) tmp[n++] = '-';
+        if(capture){
+            while(n) capture->push_back(tmp[--n]);
+            return;
         }
-        ret += "}";
-        return ret;
+        if(len + n > CHUNK_SIZE) flush();
+        while(n) buf[len++] = tmp[--n];
     }
 
-    
+    // 补空格到n个字符
+    void pad(size_t used, size_t n){
+        for(; used < n; ++used)
+            append(' ');
+    }
+};
 
-    const char * c_str(){return koopa_str.c_str();}
+// Koopa IR 文本，由 Program::dump 写入
+class KoopaString: public Emitter{
 };
 
+// 后端riscv生成时，使用到的临时标号
+class TempLabelManager{
+private:
+    int cnt;
+    const char *prefix;
+public:
+    TempLabelManager(const char *_prefix = "Label"): cnt(0), prefix(_prefix){ }
+    std::string getTmpLabel(){
+        return prefix + std::to_string(cnt++);
+    }
+};
 
-class RiscvString{
+class RiscvString: public Emitter{
 private:
-    std::string riscv_str;
+    /**
+     * 分支松弛。函数体先暂存在text中，同时按字节记录每个标号和每条条件跳转的位置。
+     * 函数结束时按实际距离决定条件跳转的形式：目标在±4KB以内的只用一条指令，
+     * 否则换成条件取反、跳过一条j的两条指令。换长的跳转会推后它之后的代码，
+     * 所以迭代到没有跳转再需要换长为止。位置按伪指令展开后最长的长度估计，只会偏大。
+    */
+    struct Branch{
+        size_t pos;     // 在text中的位置
+        int pc;         // 相对函数开头的字节数
+        std::string op, rs1, rs2, target;
+        bool far;
+    };
+    std::string text;
+    bool in_func = false;
+    int pc = 0;
+    std::unordered_map<std::string, int> label_pc;
+    std::vector<Branch> branches;
+    TempLabelManager far_labels{"Far"};
+
     /**
      * 默认只用t0 t1 t2
      * t3 t4 t5作为备用，临时的，随时可能被修改，不安全
     */
+    // 指令名，补齐到6个字符
+    void inst(std::string_view op){
+        pc += 4;
+        append("  ");
+        append(op);
+        pad(op.size(), 6);
+    }
+
+    // 访存指令 op to, offset(base)
+    void mem(std::string_view op, std::string_view r, std::string_view base, int offset){
+        if(!immediate(offset)){
+            this->li("t3", offset);
+            this->binary("add", "t3", "t3", base);
+            base = "t3";
+            offset = 0;
+        }
+        inst(op);
+        append(r);
+        append(", ");
+        appendInt(offset);
+        append('(');
+        append(base);
+        append(")\n");
+    }
 public:
     bool immediate(int i){ return -2048 <= i && i < 2048; }
 
-    void binary(const std::string &op, const std::string &rd, const std::string &rs1, const std::string &rs2){
-    riscv_str += "  " + op + std::string(6-op.length(),' ') + rd + ", " + rs1 + ", " + rs2 + "\n";
+    void binary(std::string_view op, std::string_view rd, std::string_view rs1, std::string_view rs2){
+        inst(op);
+        append(rd);
+        append(", ");
+        append(rs1);
+        append(", ");
+        append(rs2);
+        append('\n');
     }
-    
-    void two(const std::string &op, const std::string &a, const std::string &b){
-        riscv_str += "  " + op + std::string(6 - op.length(), ' ') + a + ", " + b + "\n";
+
+    // 带立即数的二元运算，如 addi rd, rs, imm
+    void binaryImm(std::string_view op, std::string_view rd, std::string_view rs, int imm){
+        inst(op);
+        append(rd);
+        append(", ");
+        append(rs);
+        append(", ");
+        appendInt(imm);
+        append('\n');
     }
 
-    void append(const std::string &s){
-        riscv_str += s;
+    void two(std::string_view op, std::string_view a, std::string_view b){
+        inst(op);
+        append(a);
+        append(", ");
+        append(b);
+        append('\n');
     }
 
-    void mov(const std::string &from, const std::string &to){
-        riscv_str += "  mv    " + to + ", "  + from + '\n';
+    using Emitter::append;
+
+    void mov(std::string_view from, std::string_view to){
+        two("mv", to, from);
     }
 
     void ret(){
-        riscv_str += "  ret\n";
+        pc += 4;
+        append("  ret\n");
     }
 
-    void li(const std::string &to, int im){
-        riscv_str += "  li    " + to + ", " + std::to_string(im) + "\n";
+    void li(std::string_view to, int im){
+        // 不是12位立即数时展开成lui和addi两条
+        if(!immediate(im) && (im & 0xfff) != 0)
+            pc += 4;
+        inst("li");
+        append(to);
+        append(", ");
+        appendInt(im);
+        append('\n');
     }
 
-    void load(const std::string &to, const std::string &base ,int offset){
-        if(offset >= -2048 && offset < 2048)
-            riscv_str += "  lw    " + to + ", " + std::to_string(offset) + "(" + base + ")\n";    
-        else{
-            this->li("t3", offset);
-            this->binary("add", "t3", "t3", base);
-            riscv_str += "  lw    " + to + ", " + "0" + "(" + "t3" + ")\n";    
-        }
+    void load(std::string_view to, std::string_view base, int offset){
+        mem("lw", to, base, offset);
     }
 
-
-    void store(const std::string &from, const std::string &base ,int offset){
-        if(offset >= -2048 && offset < 2048)
-            riscv_str += "  sw    " + from + ", " + std::to_string(offset) + "(" + base + ")\n";    
-        else{
-            this->li("t3", offset);
-            this->binary("add", "t3", "t3", base);
-            riscv_str += "  sw    " + from + ", " + "0" + "(" + "t3" + ")\n";  
-        }
+    void store(std::string_view from, std::string_view base, int offset){
+        mem("sw", from, base, offset);
     }
 
     void sp(int delta){
-        if(delta >= -2048 && delta < 2048){
-            this->binary("addi", "sp", "sp", std::to_string(delta));
+        if(immediate(delta)){
+            this->binaryImm("addi", "sp", "sp", delta);
         }else{
             this->li("t0", delta);
             this->binary("add", "sp", "sp", "t0");
         }
     }
     
-    void label(const std::string &name){
-        this->append(name + ":\n");
+    void label(std::string_view name){
+        if(in_func)
+            label_pc[std::string(name)] = pc;
+        append(name);
+        append(":\n");
     }
 
-    void bnez(const std::string &rs, const std::string &target){
+    void bnez(std::string_view rs, std::string_view target){
         this->two("bnez", rs, target);
     }
 
-    void jump(const std::string &target){
-        this->append("  j     " + target + "\n");
+    // 条件取反后的跳转指令
+    static const char *invert(std::string_view op){
+        static const char *pairs[][2] = {{"beq", "bne"}, {"blt", "bge"}, {"bgt", "ble"}};
+        for(auto &p : pairs){
+            if(op == p[0]) return p[1];
+            if(op == p[1]) return p[0];
+        }
+        return nullptr;
     }
 
-    void call(const std::string &func){
-        this->append("  call " + func + "\n");
+    // 条件跳转 op rs1, rs2, target。函数中的条件跳转等分支松弛之后再输出
+    void branch(std::string_view op, std::string_view rs1, std::string_view rs2, std::string_view target){
+        if(!in_func){
+            this->binary(op, rs1, rs2, target);
+            return;
+        }
+        branches.push_back(Branch{text.size(), pc, std::string(op), std::string(rs1),
+                                  std::string(rs2), std::string(target), false});
+        pc += 4;
+    }
+
+    void beginFunction(){
+        in_func = true;
+        pc = 0;
+        text.clear();
+        label_pc.clear();
+        branches.clear();
+        beginCapture(&text);
+    }
+
+    // 分支松弛，然后输出整个函数
+    void endFunction(){
+        endCapture();
+        in_func = false;
+        // far_before[i]: 前i条跳转中换长了的条数
+        std::vector<int> far_before(branches.size() + 1, 0);
+        auto address = [&](int p){
+            size_t i = std::lower_bound(branches.begin(), branches.end(), p,
+                [](const Branch &b, int x){ return b.pc < x; }) - branches.begin();
+            return p + 4 * far_before[i];
+        };
+        bool changed = true;
+        while(changed){
+            changed = false;
+            for(size_t i = 0; i < branches.size(); ++i)
+                far_before[i + 1] = far_before[i] + branches[i].far;
+            for(size_t i = 0; i < branches.size(); ++i){
+                auto &b = branches[i];
+                if(b.far) continue;
+                int d = address(label_pc.at(b.target)) - (b.pc + 4 * far_before[i]);
+                if(d < -4096 || d > 4094){
+                    b.far = true;
+                    changed = true;
+                }
+            }
+        }
+        size_t done = 0;
+        for(auto &b : branches){
+            append(std::string_view(text).substr(done, b.pos - done));
+            done = b.pos;
+            if(!b.far){
+                this->binary(b.op, b.rs1, b.rs2, b.target);
+            } else {
+                std::string skip = far_labels.getTmpLabel();
+                this->binary(invert(b.op), b.rs1, b.rs2, skip);
+                this->jump(b.target);
+                this->label(skip);
+            }
+        }
+        append(std::string_view(text).substr(done));
+    }
+
+    void jump(std::string_view target){
+        inst("j");
+        append(target);
+        append('\n');
+    }
+
+    void call(std::string_view func){
+        pc += 8;
+        append("  call ");
+        append(func);
+        append('\n');
     }
 
     void zeroInitInt(){
@@ -221,17 +346,82 @@ public:
     }
 
     void word(int i){
-        this->append("  .word " + std::to_string(i) + "\n");
+        append("  .word ");
+        appendInt(i);
+        append('\n');
     }
 
-    void la(const std::string &to, const std::string &name){
-        this->append("  la    " + to + ", " + name + "\n");
+    void la(std::string_view to, std::string_view name){
+        pc += 4;
+        two("la", to, name);
+    }
+
+};
+
+/**
+ * 顺序分配的内存池。只能放平凡析构的对象，对象不会被逐个析构和释放；
+ * reset后所有对象一起作废，内存块留给之后的分配复用。
+*/
+class BumpArena{
+private:
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+    struct Chunk{
+        char *data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t cur;     // 正在使用的块
+    size_t offset;  // 当前块中已经用掉的字节数
+public:
+    BumpArena(): cur(0), offset(0){}
+    BumpArena(const BumpArena &) = delete;
+    BumpArena &operator=(const BumpArena &) = delete;
+    ~BumpArena(){
+        for(auto &c : chunks)
+            ::operator delete(c.data);
+    }
+
+    void *allocate(size_t size, size_t align){
+        while(true){
+            if(cur < chunks.size()){
+                size_t p = (offset + align - 1) & ~(align - 1);
+                if(p + size <= chunks[cur].size){
+                    offset = p + size;
+                    return chunks[cur].data + p;
+                }
+                if(cur + 1 < chunks.size() && chunks[cur + 1].size >= size){
+                    ++cur;
+                    offset = 0;
+                    continue;
+                }
+            }
+            // 新开一块放在当前块之后，超过块大小的分配单独占一块
+            size_t sz = std::max(CHUNK_SIZE, size);
+            size_t pos = cur < chunks.size() ? cur + 1 : chunks.size();
+            chunks.insert(chunks.begin() + pos, Chunk{static_cast<char *>(::operator new(sz)), sz});
+            cur = pos;
+            offset = 0;
+        }
     }
 
-    const char* c_str(){
-        return riscv_str.c_str();
+    template<typename T, typename... Args>
+    T *create(Args &&... args){
+        static_assert(std::is_trivially_destructible<T>::value, "BumpArena does not run destructors");
+        return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
     }
 
+    // 复制一个长为len的字符串，末尾补\0
+    const char *copyString(const char *s, size_t len){
+        char *p = static_cast<char *>(allocate(len + 1, 1));
+        memcpy(p, s, len);
+        p[len] = '\0';
+        return p;
+    }
+
+    void reset(){
+        cur = 0;
+        offset = 0;
+    }
 };
 
 class BlockController{
@@ -253,15 +443,15 @@ public:
 
 class WhileName{
 public:
-    std::string entry_name, body_name, end_name;
-    WhileName(const std::string &_entry, const std::string & _body, const std::string &_end): entry_name(_entry), body_name(_body), end_name(_end){}
+    BasicBlock *entry, *body, *end;
+    WhileName(BasicBlock *_entry, BasicBlock *_body, BasicBlock *_end): entry(_entry), body(_body), end(_end){}
 };
 
 class WhileStack{
 private:
     std::stack<WhileName> whiles;
 public:
-    void append(const std::string &_entry, const std::string & _body, const std::string &_end){
+    void append(BasicBlock *_entry, BasicBlock *_body, BasicBlock *_end){
         whiles.emplace(_entry, _body, _end);
     }
     
@@ -269,26 +459,16 @@ public:
         whiles.pop();
     }
 
-    std::string getEntryName(){
-        return whiles.top().entry_name;
+    BasicBlock *getEntry(){
+        return whiles.top().entry;
     }
 
-    std::string getBodyName(){
-        return whiles.top().body_name;
+    BasicBlock *getBody(){
+        return whiles.top().body;
     }
 
-    std::string getEndName(){
-        return whiles.top().end_name;
+    BasicBlock *getEnd(){
+        return whiles.top().end;
     }
 };
 
-// 后端riscv生成时，使用到的临时标号
-class TempLabelManager{
-private:
-    int cnt;
-public:
-    TempLabelManager():cnt(0){ }
-    std::string getTmpLabel(){
-        return "Label" + std::to_string(cnt++);
-    }
-};
\ No newline at end of file
@@ -1,12 +1,16 @@
 #include "visit.h"
 #include "Symbol.h"
 #include "utils.h"
+#include "pass.h"
 #include <cassert>
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <cstdint>
 #include <string>
 #include <map>
+#include <vector>
+#include <algorithm>
 using namespace std;
 
 const char* op2inst[] = {
@@ -15,25 +19,39 @@ const char* op2inst[] = {
     "rem", "and", "or", "xor",
     "sll", "srl", "sra"
 };
-  
+
+// 比较运算与分支合并时的条件跳转指令
+const char* branch_inst[] = {"bne", "beq", "bgt", "blt", "bge", "ble"};
+
+// 可分配的寄存器。前NUM_CALLER_SAVED个是caller-saved，其余是callee-saved
+// t0 t1 t2 留作临时寄存器，t3 用于大偏移量的访存，a0-a7 用于传参，均不参与分配
+const char* alloc_regs[] = {
+    "t4", "t5", "t6",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11"
+};
+const int NUM_ALLOC_REGS = 15;
+const char* arg_regs[] = {"a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7"};
+const int NUM_CALLER_SAVED = 3;
+
 // 配栈上局部变量的地址
 class LocalVarAllocator{
 public:
-    unordered_map<koopa_raw_value_t, size_t> var_addr;    // 记录每个value的偏移量
+    unordered_map<Value *, size_t> var_addr;    // 记录每个value的偏移量
     // R: 函数中有call则为4，用于保存ra寄存器
     // A: 该函数调用的函数中，参数最多的那个，需要额外分配的第9,10……个参数的空间
     // S: 为这个函数的局部变量分配的栈空间
-    size_t R, A, S;
+    // C: 保存callee-saved寄存器的栈空间
+    size_t R, A, S, C;
     size_t delta;   // 16字节对齐后的栈帧长度
-    LocalVarAllocator(): R(0), A(0), S(0){} 
+    LocalVarAllocator(): R(0), A(0), S(0), C(0){}
 
     void clear(){
         var_addr.clear();
-        R = A = S = 0;
+        R = A = S = C = 0;
         delta = 0;
     }
 
-    void alloc(koopa_raw_value_t value, size_t width = 4){
+    void alloc(Value *value, size_t width = 4){
         var_addr.insert(make_pair(value, S));
         S += width;
     }
@@ -46,92 +64,547 @@ public:
         A = A > a ? A : a;
     }
 
-    bool exists(koopa_raw_value_t value){
+    void setC(size_t n){
+        C = 4 * n;
+    }
+
+    bool exists(Value *value){
         return var_addr.find(value) != var_addr.end();
     }
-    
-    size_t getOffset(koopa_raw_value_t value){
+
+    size_t getOffset(Value *value){
         // 大小为A的位置存函数参数
         return var_addr[value] + A;
     }
 
+    // 第i个callee-saved寄存器的保存位置
+    size_t getCalleeOffset(size_t i){
+        return A + S + 4 * i;
+    }
+
     void getDelta(){
-        int d = S + R + A;
+        int d = S + R + A + C;
         delta = d%16 ? d + 16 - d %16: d;
     }
 };
 
-// 函数控制器，用于确定当前函数的参数是第几个
-class FunctionController{
+// 地址计算的选择
+// getelemptr/getptr的结果只被load/store当作地址使用时不单独计算，而是并入使用它的访存指令：
+// 整条指针链上的常量下标合并成lw/sw的立即数偏移，变量下标各自乘以步长后累加，最后只加一次基址。
+// 变量下标的部分在每个使用处都要重新计算，所以只有一处使用时才合并。
+class AddressSelector{
 private:
-    koopa_raw_function_t func;  //当前访问的函数
-public:
-    FunctionController() = default;
-    void setFunc(koopa_raw_function_t f){
-        func = f;
-    }
-    int getParamNum(koopa_raw_value_t v){
-        int i = 0;
-        for(; i < func->params.len; ++i){
-            if(func->params.buffer[i] == (void *)v)
+    // 合并后地址计算会在几处展开(-1表示不能合并)，以及是否都在它自己的基本块中展开
+    struct Emit{
+        int n;
+        bool local;
+    };
+    unordered_map<Value *, Emit> emit_count;
+
+    static bool isAddr(Value *v){
+        return v->tag == Value::GET_PTR || v->tag == Value::GET_ELEM_PTR;
+    }
+
+    Emit count(Value *v){
+        auto it = emit_count.find(v);
+        if(it != emit_count.end())
+            return it->second;
+        Emit e{0, true};
+        for(auto u : v->users){
+            if(u->tag == Value::LOAD || (u->tag == Value::STORE && u->ops[0] != v)){
+                ++e.n;
+                e.local = e.local && u->bb == v->bb;
+            } else if(isAddr(u) && u->ops[1] != v){
+                if(isFolded(u)){
+                    Emit f = count(u);
+                    e.n += f.n;
+                    e.local = e.local && f.local && u->bb == v->bb;
+                } else {
+                    ++e.n;
+                    e.local = e.local && u->bb == v->bb;
+                }
+            } else {
+                e.n = -1;
                 break;
+            }
         }
-        return i;
+        emit_count[v] = e;
+        return e;
+    }
+
+public:
+    void clear(){
+        emit_count.clear();
+    }
+
+    // 该value的地址计算是否并入了它的使用者。变量下标的地址被提到循环外时不合并，否则又会在循环中计算
+    bool isFolded(Value *v){
+        if(!isAddr(v))
+            return false;
+        Emit e = count(v);
+        return e.n >= 0 && (v->ops[1]->tag == Value::INTEGER || (e.n <= 1 && e.local));
     }
 };
 
 RiscvString rvs;
 LocalVarAllocator lva;
-FunctionController fc;
 TempLabelManager tlm;
+AddressSelector asel;
+BasicBlock *next_bb;    // 紧跟在当前基本块之后发射的基本块，跳到它可以直接落下去
+Value *t2_global;       // t2中是这个全局变量的地址，同一基本块中之后访问它时不再la。t2被改写时清空
 
-// 访问 raw program
-void Visit(const koopa_raw_program_t &program) {
-    // 执行一些其他的必要操作
-    
-    // 访问所有全局变量
-    Visit(program.values);
-    // 访问所有函数
-    Visit(program.funcs);
-}
-
-// 访问 raw slice
-void Visit(const koopa_raw_slice_t &slice) {
-    for (size_t i = 0; i < slice.len; ++i) {
-        auto ptr = slice.buffer[i];
-        // 根据 slice 的 kind 决定将 ptr 视作何种元素
-        switch (slice.kind) {
-        case KOOPA_RSIK_FUNCTION:
-            // 访问函数
-            Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
-            break;
-        case KOOPA_RSIK_BASIC_BLOCK:
-            // 访问基本块
-            Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
-            break;
-        case KOOPA_RSIK_VALUE:
-            // 访问指令/全局变量
-            Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
-            break;
+// 只被一条branch当作条件使用的比较运算，不计算出0/1，直接合并到条件跳转指令中
+bool isFusedCond(Value *value){
+    return value->tag == Value::BINARY && value->op <= Value::LE
+        && value->users.size() == 1 && value->users[0]->tag == Value::BRANCH
+        && value->users[0]->ops[0] == value;
+}
+
+// 该value是否有计算结果，需要分配寄存器
+bool needReg(Value *value){
+    switch(value->tag){
+        case Value::GET_PTR:
+        case Value::GET_ELEM_PTR:
+            return !asel.isFolded(value);
+        case Value::BINARY:
+            return !isFusedCond(value);
+        case Value::LOAD:
+        case Value::FUNC_ARG:
+        case Value::BLOCK_ARG:
+            return true;
+        case Value::CALL:
+            return value->ty->tag == IRType::INT32;
         default:
-            // 我们暂时不会遇到其他内容, 于是不对其做任何处理
-            assert(false);
+            return false;
+    }
+}
+
+static void addOperands(Value *value, vector<Value *> &ops){
+    for(auto o : value->ops){
+        if(needReg(o))
+            ops.push_back(o);
+        else if(asel.isFolded(o) || isFusedCond(o))
+            addOperands(o, ops);    // 合并到使用处计算的，用到的是它自己的操作数
+    }
+}
+
+// 收集一条指令中需要分配寄存器的操作数
+void getOperands(Value *value, vector<Value *> &ops){
+    ops.clear();
+    addOperands(value, ops);
+}
+
+// 线性扫描寄存器分配
+// 先按基本块的发射顺序给指令编号，经活跃变量分析得到每个value的活跃区间，
+// 再按区间起点扫描，为每个区间分配寄存器，寄存器不够时溢出到栈上。
+// 活跃区间跨过call指令的value只能使用callee-saved寄存器。
+class LinearScanAllocator{
+private:
+    struct Interval{
+        Value *value;
+        int start, end;
+        bool cross_call;
+    };
+    unordered_map<Value *, int> reg;      // value -> alloc_regs下标, -1表示溢出到栈上
+    vector<bool> callee_used;
+
+public:
+    vector<string> used_callee;     // 用到的callee-saved寄存器，需要在prologue中保存
+
+    void run(Function *func, const vector<BasicBlock *> &order){
+        reg.clear();
+        used_callee.clear();
+        callee_used.assign(NUM_ALLOC_REGS, false);
+
+        // 1. 编号。函数参数在位置0定义，每个基本块的入口占一个位置
+        unordered_map<BasicBlock *, int> bb_id;
+        int n = order.size();
+        for(int i = 0; i < n; ++i)
+            bb_id[order[i]] = i;
+        vector<int> bb_from(n), bb_to(n);
+        unordered_map<Value *, Interval> itv;
+        unordered_map<Value *, int> def_bb;
+        vector<int> call_pos;
+        vector<Value *> ops;
+
+        vector<Value *> values;  // 按定义顺序排列的value
+        auto define = [&](Value *v, int pos, int b){
+            itv[v] = Interval{v, pos, -1, false};
+            def_bb[v] = b;
+            values.push_back(v);
+        };
+        for(auto param : func->params)
+            define(param, 0, 0);
+        int p = 2;
+        for(int b = 0; b < n; ++b){
+            auto bb = order[b];
+            bb_from[b] = p;
+            for(auto param : bb->params)
+                define(param, p, b);
+            p += 2;
+            for(auto v : bb->insts){
+                if(v->tag == Value::CALL)
+                    call_pos.push_back(p);
+                if(needReg(v))
+                    define(v, p, b);
+                p += 2;
+            }
+            bb_to[b] = p - 2;
+        }
+        // 记录每个value最后一次被使用的位置
+        p = 2;
+        for(int b = 0; b < n; ++b){
+            auto bb = order[b];
+            p += 2;
+            for(auto v : bb->insts){
+                getOperands(v, ops);
+                for(auto o : ops){
+                    auto it = itv.find(o);
+                    if(it != itv.end())
+                        it->second.end = max(it->second.end, p);
+                }
+                p += 2;
+            }
+        }
+
+        // 2. 在定义所在基本块之外被使用的value才需要做活跃变量分析，记下使用它的基本块
+        unordered_map<Value *, int> gid;
+        vector<Interval *> globals;
+        vector<int> global_def;
+        vector<vector<int>> use_bbs;
+        for(int b = 0; b < n; ++b){
+            auto bb = order[b];
+            for(auto v : bb->insts){
+                getOperands(v, ops);
+                for(auto o : ops){
+                    auto d = def_bb.find(o);
+                    if(d == def_bb.end() || d->second == b)
+                        continue;
+                    auto g = gid.find(o);
+                    int k;
+                    if(g == gid.end()){
+                        k = globals.size();
+                        gid[o] = k;
+                        globals.push_back(&itv[o]);
+                        global_def.push_back(d->second);
+                        use_bbs.emplace_back();
+                    } else {
+                        k = g->second;
+                    }
+                    if(use_bbs[k].empty() || use_bbs[k].back() != b)
+                        use_bbs[k].push_back(b);
+                }
+            }
+        }
+
+        // 3. 从使用它的基本块沿前驱往回走，直到定义所在的基本块：经过的基本块入口处活跃，它们的前驱出口处活跃，
+        //    据此扩展区间。每个value只访问它活跃的基本块，时间和空间与活跃范围的总大小成正比，不用n×value个数的位向量
+        vector<vector<int>> preds(n);
+        for(int b = 0; b < n; ++b){
+            for(auto s : order[b]->getSuccs())
+                preds[bb_id[s]].push_back(b);
         }
+        vector<int> in_mark(n, -1), out_mark(n, -1), work;
+        for(int k = 0; k < (int)globals.size(); ++k){
+            Interval *it = globals[k];
+            work = use_bbs[k];
+            for(int b : work)
+                in_mark[b] = k;
+            while(!work.empty()){
+                int b = work.back();
+                work.pop_back();
+                it->start = min(it->start, bb_from[b]);
+                it->end = max(it->end, bb_from[b]);
+                for(int q : preds[b]){
+                    if(out_mark[q] != k){
+                        out_mark[q] = k;
+                        it->end = max(it->end, bb_to[q]);
+                    }
+                    if(q != global_def[k] && in_mark[q] != k){
+                        in_mark[q] = k;
+                        work.push_back(q);
+                    }
+                }
+            }
+        }
+
+        // 4. 线性扫描。没有被使用的value不分配位置
+        vector<Interval> list;
+        for(auto v : values){
+            auto &it = itv[v];
+            if(it.end < 0) continue;
+            auto c = upper_bound(call_pos.begin(), call_pos.end(), it.start);
+            it.cross_call = c != call_pos.end() && *c < it.end;
+            list.push_back(it);
+        }
+        stable_sort(list.begin(), list.end(), [](const Interval &a, const Interval &b){
+            return a.start < b.start;
+        });
+
+        vector<Interval> active;
+        vector<bool> reg_free(NUM_ALLOC_REGS, true);
+        for(auto &cur : list){
+            // 释放已经结束的区间。操作数在指令开始时就已读出，所以结束于cur.start的区间也可以释放
+            for(size_t i = 0; i < active.size(); ){
+                if(active[i].end <= cur.start){
+                    reg_free[reg[active[i].value]] = true;
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+            int r = -1;
+            if(!cur.cross_call){
+                for(int i = 0; i < NUM_CALLER_SAVED && r < 0; ++i)
+                    if(reg_free[i]) r = i;
+            }
+            for(int i = NUM_CALLER_SAVED; i < NUM_ALLOC_REGS && r < 0; ++i)
+                if(reg_free[i]) r = i;
+            if(r >= 0){
+                reg_free[r] = false;
+                reg[cur.value] = r;
+                active.push_back(cur);
+                continue;
+            }
+            // 没有空闲寄存器，溢出结束最晚的那个区间
+            int victim = -1;
+            for(size_t i = 0; i < active.size(); ++i){
+                if(cur.cross_call && reg[active[i].value] < NUM_CALLER_SAVED)
+                    continue;
+                if(victim < 0 || active[i].end > active[victim].end)
+                    victim = i;
+            }
+            if(victim >= 0 && active[victim].end > cur.end){
+                r = reg[active[victim].value];
+                spill(active[victim].value);
+                active[victim] = cur;
+                reg[cur.value] = r;
+            } else {
+                spill(cur.value);
+            }
+        }
+
+        for(auto &kv : reg){
+            if(kv.second >= NUM_CALLER_SAVED && !callee_used[kv.second]){
+                callee_used[kv.second] = true;
+            }
+        }
+        for(int i = NUM_CALLER_SAVED; i < NUM_ALLOC_REGS; ++i){
+            if(callee_used[i])
+                used_callee.push_back(alloc_regs[i]);
+        }
+    }
+
+    void spill(Value *v){
+        reg[v] = -1;
+        // 第9个及以后的参数本来就在caller的栈帧中
+        if(v->tag == Value::FUNC_ARG && v->value >= 8)
+            return;
+        lva.alloc(v);
+    }
+
+    // value是否分配了位置（寄存器或栈）
+    bool isAllocated(Value *v){
+        return reg.find(v) != reg.end();
     }
+
+    bool hasReg(Value *v){
+        auto it = reg.find(v);
+        return it != reg.end() && it->second >= 0;
+    }
+
+    bool isSpilled(Value *v){
+        auto it = reg.find(v);
+        return it != reg.end() && it->second < 0;
+    }
+
+    string getReg(Value *v){
+        return alloc_regs[reg[v]];
+    }
+
+    // 溢出的value相对sp的偏移
+    int getOffset(Value *v){
+        if(v->tag == Value::FUNC_ARG && v->value >= 8)
+            return lva.delta + (v->value - 8) * 4;
+        return lva.getOffset(v);
+    }
+};
+
+LinearScanAllocator lsra;
+
+// IR中的名字去掉开头的@或%，即汇编中的符号名
+string_view symbol(const string &name){
+    return string_view(name).substr(1);
+}
+
+// 把value的值放到寄存器中，返回该寄存器。value不在寄存器中时借用临时寄存器tmp
+string loadValue(Value *value, const string &tmp){
+    if(value->tag == Value::UNDEF)
+        return "x0";
+    if(value->tag == Value::INTEGER){
+        int i = value->value;
+        if(i == 0) return "x0";
+        rvs.li(tmp, i);
+        return tmp;
+    }
+    if(lsra.hasReg(value))
+        return lsra.getReg(value);
+    rvs.load(tmp, "sp", lsra.getOffset(value));
+    return tmp;
+}
+
+// 指令的计算结果应写入的寄存器
+string getDestReg(Value *value){
+    return lsra.hasReg(value) ? lsra.getReg(value) : "t0";
+}
+
+// 计算结果被溢出到栈上时，把寄存器r写回
+void saveValue(Value *value, const string &r){
+    if(lsra.isSpilled(value))
+        rvs.store(r, "sp", lsra.getOffset(value));
+}
+
+// value所在的位置：寄存器，或者栈上的偏移量
+struct Location{
+    string reg;     // 为空表示在栈上
+    int offset;
+    bool operator==(const Location &o) const{
+        return reg == o.reg && (!reg.empty() || offset == o.offset);
+    }
+};
+
+// 访存的地址 offset(base)
+struct Address{
+    string base;
+    int offset;
+};
+Address getAddress(Value *ptr, bool self = false, const string &dst = "t1");
+
+Location getLocation(Value *value){
+    if(lsra.hasReg(value))
+        return Location{lsra.getReg(value), 0};
+    return Location{"", lsra.getOffset(value)};
+}
+
+// 把src复制到dst，src为空时表示立即数imm。t1用于栈到栈的复制
+void emitMove(const Location &dst, const Location *src, int imm){
+    string r;
+    if(src == nullptr){
+        if(!dst.reg.empty()){
+            rvs.li(dst.reg, imm);
+            return;
+        }
+        r = imm == 0 ? "x0" : "t1";
+        if(imm != 0) rvs.li(r, imm);
+    } else if(src->reg.empty()){
+        r = dst.reg.empty() ? "t1" : dst.reg;
+        rvs.load(r, "sp", src->offset);
+        if(!dst.reg.empty()) return;
+    } else {
+        r = src->reg;
+        if(!dst.reg.empty()){
+            rvs.mov(r, dst.reg);
+            return;
+        }
+    }
+    rvs.store(r, "sp", dst.offset);
+}
+
+// 基本块参数的一次复制
+struct Move{
+    Location dst, src;
+    bool is_imm;
+    int imm;
+};
+
+// 沿跳转指令jump的第k个目标跳转时，需要把实参复制到目标基本块参数的位置
+void getBlockArgMoves(Value *jump, int k, vector<Move> &moves){
+    BasicBlock *target = jump->target[k];
+    int begin = jump->argBegin(k);
+    moves.clear();
+    for(size_t i = 0; i < target->params.size(); ++i){
+        Value *param = target->params[i];
+        Value *arg = jump->ops[begin + i];
+        if(!lsra.isAllocated(param))
+            continue;
+        Move m{getLocation(param), Location{"", 0}, true, 0};
+        if(arg->tag == Value::INTEGER){
+            m.imm = arg->value;
+        } else if(arg->tag != Value::UNDEF){
+            m.is_imm = false;
+            m.src = getLocation(arg);
+            if(m.src == m.dst)
+                continue;
+        }
+        moves.push_back(m);
+    }
+}
+
+// 并行地完成这些复制
+// 先做目的位置不再被读取的复制，剩下的构成环，借助t0打破
+void emitMoves(vector<Move> &moves){
+    while(!moves.empty()){
+        size_t i = 0;
+        for(; i < moves.size(); ++i){
+            bool blocked = false;
+            for(size_t j = 0; j < moves.size() && !blocked; ++j)
+                blocked = j != i && !moves[j].is_imm && moves[j].src == moves[i].dst;
+            if(!blocked) break;
+        }
+        if(i == moves.size()){
+            // 全部在环上。把第一个的目的位置的旧值存到t0
+            Location tmp{"t0", 0};
+            Location old = moves[0].dst;
+            emitMove(tmp, &old, 0);
+            for(auto &m : moves){
+                if(!m.is_imm && m.src == old)
+                    m.src = tmp;
+            }
+            i = 0;
+        }
+        emitMove(moves[i].dst, moves[i].is_imm ? nullptr : &moves[i].src, moves[i].imm);
+        moves.erase(moves.begin() + i);
+    }
+}
+
+void moveBlockArgs(Value *jump, int k){
+    vector<Move> moves;
+    getBlockArgMoves(jump, k, moves);
+    emitMoves(moves);
+}
+
+// 访问 IR program
+void Visit(Program *program) {
+    // 访问所有全局变量
+    for(auto g : program->globals)
+        VisitGlobalVar(g);
+    // 访问所有函数
+    for(auto f : program->funcs)
+        Visit(f);
 }
 
 // 访问函数
-void Visit(const koopa_raw_function_t &func) {
-    if(func->bbs.len == 0) return;
-    fc.setFunc(func);
+void Visit(Function *func) {
+    if(func->isDecl()) return;
 
+    rvs.beginFunction();
     rvs.append("  .text\n");
-    rvs.append("  .globl " + string(func->name + 1) + "\n");
-    rvs.append(string(func->name + 1)+ ":\n");
+    rvs.append("  .globl ");
+    rvs.append(symbol(func->name));
+    rvs.append('\n');
+    rvs.label(symbol(func->name));
+
+    // 基本块的发射顺序，entry block在最前
+    vector<BasicBlock *> order = layoutBlocks(func);
 
     lva.clear();
+    asel.clear();
     // 先扫一遍完成局部变量分配
     allocLocal(func);
+    // 寄存器分配，溢出的value在栈上分配空间
+    lsra.run(func, order);
+    lva.setC(lsra.used_callee.size());
     lva.getDelta();
 
     //  函数的 prologue
@@ -140,101 +613,107 @@ void Visit(const koopa_raw_function_t &func) {
     if(lva.R){
         rvs.store("ra", "sp", (int)lva.delta - 4);
     }
-
-
-    // 找到entry block
-    size_t e = 0;
-    for(e = 0; e < func->bbs.len; ++e){
-        auto ptr = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[e]);
-        if(ptr->name && !strcmp(ptr->name, "%entry")){
-            break;
+    for(size_t i = 0; i < lsra.used_callee.size(); ++i){
+        rvs.store(lsra.used_callee[i], "sp", lva.getCalleeOffset(i));
+    }
+    // 把参数放到分配给它的位置
+    for(size_t i = 0; i < func->params.size(); ++i){
+        auto v = func->params[i];
+        if(lsra.hasReg(v)){
+            if(i < 8)
+                rvs.mov(arg_regs[i], lsra.getReg(v));
+            else
+                rvs.load(lsra.getReg(v), "sp", lva.delta + (i - 8) * 4);
+        } else if(i < 8){
+            saveValue(v, arg_regs[i]);
         }
     }
-    // 访问 entry block
-    Visit(reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[e]));
 
-    for(size_t i = 0; i < func->bbs.len; ++i){
-        if(i == e) continue;
-        auto ptr = func->bbs.buffer[i];
-        Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
+    for(size_t i = 0; i < order.size(); ++i){
+        next_bb = i + 1 < order.size() ? order[i + 1] : nullptr;
+        Visit(order[i]);
     }
 
     // 函数的 epilogue 在ret指令完成
     rvs.append("\n\n");
+    rvs.endFunction();
 }
 
 // 访问基本块
-void Visit(const koopa_raw_basic_block_t &bb) {
-    if(bb->name && strcmp(bb->name, "%entry")){
-        rvs.label(string(bb->name + 1));
-    }
-    for(size_t i = 0; i < bb->insts.len; ++i){
-        auto ptr = bb->insts.buffer[i];
-        Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
+void Visit(BasicBlock *bb) {
+    if(bb != bb->func->bbs[0]){
+        rvs.label(symbol(bb->name));
     }
+    t2_global = nullptr;
+    for(auto v : bb->insts)
+        Visit(v);
 }
 
 // 访问指令
-void Visit(const koopa_raw_value_t &value) {
+void Visit(Value *value) {
     // 根据指令类型判断后续需要如何访问
-    const auto &kind = value->kind;
-
-    switch (kind.tag) {
-        case KOOPA_RVT_RETURN:
+    switch (value->tag) {
+        case Value::RETURN:
             // 访问 return 指令
-            Visit(kind.data.ret);
-            break;
-        case KOOPA_RVT_INTEGER:
-            // 访问 integer 指令
-            rvs.append("Control flow should never reach here.\n");
-            Visit(kind.data.integer);
+            VisitReturn(value);
             break;
-        case KOOPA_RVT_BINARY:
-            // 访问二元运算
-            Visit(kind.data.binary);
-            rvs.store("t0", "sp", lva.getOffset(value));
+        case Value::BINARY:{
+            // 访问二元运算。合并到分支中的比较在branch处生成
+            if(isFusedCond(value))
+                break;
+            string rd = getDestReg(value);
+            VisitBinary(value, rd);
+            saveValue(value, rd);
             break;
-        case KOOPA_RVT_ALLOC:
+        }
+        case Value::ALLOC:
             // 访问栈分配指令，啥都不用管
             break;
-        
-        case KOOPA_RVT_LOAD:
+
+        case Value::LOAD:{
             // 加载指令
-            Visit(kind.data.load);
-            rvs.store("t0", "sp", lva.getOffset(value));
+            string rd = getDestReg(value);
+            VisitLoad(value, rd);
+            saveValue(value, rd);
             break;
-
-        case KOOPA_RVT_STORE:
+        }
+        case Value::STORE:
             // 存储指令
-            Visit(kind.data.store);
+            VisitStore(value);
             break;
-        case KOOPA_RVT_BRANCH:
+        case Value::BRANCH:
             // 条件分支指令
-            Visit(kind.data.branch);
+            VisitBranch(value);
             break;
-        case KOOPA_RVT_JUMP:
+        case Value::JUMP:
             // 无条件跳转指令
-            Visit(kind.data.jump);
+            VisitJump(value);
             break;
-        case KOOPA_RVT_CALL:
+        case Value::CALL:
             // 访问函数调用
-            Visit(kind.data.call);
-            if(kind.data.call.callee->ty->data.function.ret->tag == KOOPA_RTT_INT32){
-                rvs.store("a0", "sp", lva.getOffset(value));
+            VisitCall(value);
+            if(lsra.hasReg(value)){
+                rvs.mov("a0", lsra.getReg(value));
             }
+            saveValue(value, "a0");
             break;
-        case KOOPA_RVT_GLOBAL_ALLOC:
-            // 访问全局变量
-            VisitGlobalVar(value);
+        case Value::GET_ELEM_PTR:{
+            // 访问getelemptr指令。并入访存指令的地址不单独计算
+            if(asel.isFolded(value))
+                break;
+            string rd = getDestReg(value);
+            VisitGetElemPtr(value, rd);
+            saveValue(value, rd);
             break;
-        case KOOPA_RVT_GET_ELEM_PTR:
-            // 访问getelemptr指令
-            Visit(kind.data.get_elem_ptr);
-            rvs.store("t0", "sp", lva.getOffset(value));
+        }
+        case Value::GET_PTR:{
+            if(asel.isFolded(value))
+                break;
+            string rd = getDestReg(value);
+            VisitGetPtr(value, rd);
+            saveValue(value, rd);
             break;
-        case KOOPA_RVT_GET_PTR:
-            Visit(kind.data.get_ptr);
-            rvs.store("t0", "sp", lva.getOffset(value));
+        }
         default:
             // 其他类型暂时遇不到
             break;
@@ -242,18 +721,21 @@ void Visit(const koopa_raw_value_t &value) {
 }
 
 // 访问return指令
-void Visit(const koopa_raw_return_t &value) {
-    if(value.value != nullptr) {
-        koopa_raw_value_t ret_value = value.value;
+void VisitReturn(Value *ret) {
+    if(!ret->ops.empty()) {
+        Value *ret_value = ret->ops[0];
         // 特判return一个整数情况
-        if(ret_value->kind.tag == KOOPA_RVT_INTEGER){
-            int i = Visit(ret_value->kind.data.integer);
-            rvs.li("a0", i);
+        if(ret_value->tag == Value::INTEGER){
+            rvs.li("a0", ret_value->value);
         } else{
-            int i = lva.getOffset(ret_value);
-            rvs.load("a0", "sp", i);
+            string r = loadValue(ret_value, "a0");
+            if(r != "a0")
+                rvs.mov(r, "a0");
         }
     }
+    for(size_t i = 0; i < lsra.used_callee.size(); ++i){
+        rvs.load(lsra.used_callee[i], "sp", lva.getCalleeOffset(i));
+    }
     if(lva.R){
         rvs.load("ra", "sp", lva.delta - 4);
     }
@@ -262,328 +744,295 @@ void Visit(const koopa_raw_return_t &value) {
     rvs.ret();
 }
 
-// 访问koopa_raw_integer_t,结果返回数值
-int Visit(const koopa_raw_integer_t &value){
-    return value.value;
-}
-
-// 访问koopa_raw_binary_t
-void  Visit(const koopa_raw_binary_t &value){
+// 访问二元运算，结果写入rd
+void VisitBinary(Value *value, const string &rd){
 
-    // 把左右操作数加载到t0,t1寄存器
-    koopa_raw_value_t l = value.lhs, r = value.rhs;
-    int i;
-    if(l->kind.tag == KOOPA_RVT_INTEGER){
-        i = Visit(l->kind.data.integer);
-        rvs.li("t0", i);
-    }else{
-        i = lva.getOffset(l);
-        rvs.load("t0", "sp", i);
-    }
-    if(r->kind.tag == KOOPA_RVT_INTEGER){
-        i = Visit(r->kind.data.integer);
-        rvs.li("t1", i);
-    }else {
-        i = lva.getOffset(r);
-        rvs.load("t1", "sp", i);
-    }
-    // 判断操作符
-    if(value.op == KOOPA_RBO_NOT_EQ){
-        rvs.binary("xor", "t0" ,"t0", "t1");
-        rvs.two("snez", "t0", "t0");
-    }else if(value.op == KOOPA_RBO_EQ){
-        rvs.binary("xor", "t0" ,"t0", "t1");
-        rvs.two("seqz", "t0", "t0");
-    }else if(value.op == KOOPA_RBO_GE){
-        rvs.binary("slt", "t0", "t0", "t1");
-        rvs.two("seqz", "t0", "t0");
-    }else if(value.op == KOOPA_RBO_LE){
-        rvs.binary("sgt", "t0", "t0", "t1");
-        rvs.two("seqz", "t0", "t0");
+    // 把左右操作数加载到寄存器，不在寄存器中的借用t0,t1
+    string l = loadValue(value->ops[0], "t0");
+    string r = loadValue(value->ops[1], "t1");
+    // 判断操作符。rd可能与操作数是同一个寄存器，rd只在最后一条指令写入
+    if(value->op == Value::NE){
+        rvs.binary("xor", "t0" ,l, r);
+        rvs.two("snez", rd, "t0");
+    }else if(value->op == Value::EQ){
+        rvs.binary("xor", "t0" ,l, r);
+        rvs.two("seqz", rd, "t0");
+    }else if(value->op == Value::GE){
+        rvs.binary("slt", "t0", l, r);
+        rvs.two("seqz", rd, "t0");
+    }else if(value->op == Value::LE){
+        rvs.binary("sgt", "t0", l, r);
+        rvs.two("seqz", rd, "t0");
     }else{
-        string op = op2inst[(int)value.op];
-        rvs.binary(op, "t0", "t0", "t1");
+        string op = op2inst[(int)value->op];
+        rvs.binary(op, rd, l, r);
     }
 
 }
 
-// 访问load指令
-void Visit(const koopa_raw_load_t &load){
-    koopa_raw_value_t src = load.src;
-
-    if(src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        // 全局变量
-        rvs.la("t0", string(src->name + 1));
-        rvs.load("t0", "t0", 0);
-    } else if(src->kind.tag == KOOPA_RVT_ALLOC){
-        // 栈分配
-        int i = lva.getOffset(src);
-        rvs.load("t0", "sp", i);
-    } else{
-        rvs.load("t0", "sp", lva.getOffset(src));
-        rvs.load("t0", "t0", 0);
-    }
+// 访问load指令，结果写入rd
+void VisitLoad(Value *load, const string &rd){
+    Address a = getAddress(load->ops[0]);
+    rvs.load(rd, a.base, a.offset);
 }
 
 // 访问store指令
-void Visit(const koopa_raw_store_t &store){
-    koopa_raw_value_t v = store.value, d = store.dest;
-
-    int i, j;
-    if(v->kind.tag == KOOPA_RVT_FUNC_ARG_REF){
-        i = fc.getParamNum(v);
-        if(i < 8){
-            string reg = "a" + to_string(i);
-            if(d->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-                rvs.la("t0", string(d->name + 1));
-                rvs.store(reg, "t0", 0);
-            }else if(d->kind.tag == KOOPA_RVT_ALLOC){
-                rvs.store(reg,  "sp", lva.getOffset(d));
-            }else{
-                // 间接引用
-                rvs.load("t0", "sp", lva.getOffset(d));
-                rvs.store(reg, "t0", 0);
-            }
-            return;
-        } else{
-            i = (i - 8) * 4;
-            rvs.load("t0", "sp", i + lva.delta);    // caller 栈帧中
-        }
-    }else if(v->kind.tag == KOOPA_RVT_INTEGER){
-        rvs.li("t0", Visit(v->kind.data.integer));
-    } else{
-        i = lva.getOffset(v);
-        rvs.load("t0", "sp", i);
-    }
-    if(d->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        rvs.la("t1", string(d->name + 1));
-        rvs.store("t0", "t1", 0);
-    } else if(d->kind.tag == KOOPA_RVT_ALLOC){
-        j = lva.getOffset(d);
-        rvs.store("t0", "sp", j);
-    } else {
-        rvs.load("t1", "sp", lva.getOffset(d));
-        rvs.store("t0","t1", 0);
-    }
-    
-    return;
+void VisitStore(Value *store){
+    // 先算地址，地址只用t1,t2，要存的值可以借用t0
+    Address a = getAddress(store->ops[1]);
+    string val = loadValue(store->ops[0], "t0");
+    rvs.store(val, a.base, a.offset);
 }
 
 // 访问branch指令
-void Visit(const koopa_raw_branch_t &branch){
-    auto true_bb = branch.true_bb;
-    auto false_bb = branch.false_bb;
-    koopa_raw_value_t v = branch.cond;
-    if(v->kind.tag == KOOPA_RVT_INTEGER){
-        rvs.li("t0", Visit(v->kind.data.integer));
-    }else{
-        rvs.load("t0", "sp", lva.getOffset(v));
-    }
-    // 这里，用条件跳转指令跳转范围只有4KB，过不了long_func测试用例
-    // 1MB。
-    // 因此只用bnez实现分支，然后用jump调到目的地。
-    string tmp_label = tlm.getTmpLabel();
-    rvs.bnez("t0", tmp_label);
-    rvs.jump(string(false_bb->name + 1));
-    rvs.label(tmp_label);
-    rvs.jump(string(true_bb->name + 1));
+void VisitBranch(Value *branch){
+    // 条件是只被这条branch使用的比较时，直接用对应的条件跳转指令，否则与0比较
+    Value *cond = branch->ops[0];
+    int op = Value::NE;
+    string l, r = "x0";
+    if(isFusedCond(cond)){
+        op = cond->op;
+        l = loadValue(cond->ops[0], "t0");
+        r = loadValue(cond->ops[1], "t1");
+    } else {
+        l = loadValue(cond, "t0");
+    }
+    // 条件跳转直接跳到目标taken，另一个目标紧跟在后面时落下去，否则用j跳过去。
+    // 条件跳转的范围只有±4KB，超出的由分支松弛换成两条指令。
+    // 基本块参数的复制放在各自的跳转之前：taken一边有复制而另一边没有时交换两边，
+    // 两边都有时条件跳转先跳到一个临时标号，在那里复制后再跳过去。
+    // 临时标号处的代码在最后，这时让紧跟在后面的目标作为taken，从那里落下去
+    vector<Move> moves[2];
+    getBlockArgMoves(branch, 0, moves[0]);
+    getBlockArgMoves(branch, 1, moves[1]);
+    bool use_stub = !moves[0].empty() && !moves[1].empty();
+    int taken = branch->target[0] == next_bb ? 1 : 0;
+    if(use_stub || (!moves[taken].empty() && moves[taken ^ 1].empty()))
+        taken ^= 1;
+    int other = taken ^ 1;
+    const char *inst = taken == 0 ? branch_inst[op] : RiscvString::invert(branch_inst[op]);
+    string stub;
+    if(!use_stub){
+        rvs.branch(inst, l, r, symbol(branch->target[taken]->name));
+    } else {
+        stub = tlm.getTmpLabel();
+        rvs.branch(inst, l, r, stub);
+    }
+    emitMoves(moves[other]);
+    if(use_stub || branch->target[other] != next_bb)
+        rvs.jump(symbol(branch->target[other]->name));
+    if(!stub.empty()){
+        rvs.label(stub);
+        emitMoves(moves[taken]);
+        if(branch->target[taken] != next_bb)
+            rvs.jump(symbol(branch->target[taken]->name));
+    }
     return;
 }
 
 // 访问jump指令
-void Visit(const koopa_raw_jump_t &jump){
-    auto name = string(jump.target->name + 1);
-    rvs.jump(name);
+void VisitJump(Value *jump){
+    moveBlockArgs(jump, 0);
+    // 目标紧跟在后面时直接落下去
+    if(jump->target[0] != next_bb)
+        rvs.jump(symbol(jump->target[0]->name));
     return;
 }
 
 // 访问 call 指令
-void Visit(const koopa_raw_call_t &call){
-    for(int i = 0; i < call.args.len; ++i){
-        koopa_raw_value_t v = (koopa_raw_value_t)call.args.buffer[i];
-        if(v->kind.tag == KOOPA_RVT_INTEGER){
-            int j = Visit(v->kind.data.integer);
-            if(i < 8){
-                rvs.li("a" + to_string(i), j);
-            } else {
-                rvs.li("t0", j);
-                rvs.store("t0", "sp", (i - 8) * 4);
-            }
-        } else{
-            int off = lva.getOffset(v);
-            if(i < 8){
-                rvs.load("a" + to_string(i), "sp", off);
-            } else {
-                rvs.load("t0", "sp", off);
-                rvs.store("t0", "sp", (i - 8) * 4);
-            }
+void VisitCall(Value *call){
+    for(size_t i = 0; i < call->ops.size(); ++i){
+        Value *v = call->ops[i];
+        if(i < 8){
+            const char *a = arg_regs[i];
+            string r = loadValue(v, a);
+            if(r != a)
+                rvs.mov(r, a);
+        } else {
+            string r = loadValue(v, "t0");
+            rvs.store(r, "sp", (i - 8) * 4);
         }
     }
-    rvs.call(string(call.callee->name + 1));
-    // if(call.callee->ty->data.function.ret->tag ==KOOPA_RTT_INT32)
-  
+    rvs.call(symbol(call->callee->name));
+    t2_global = nullptr;
     return;
 }
 
 // 访问全局变量
-void VisitGlobalVar(koopa_raw_value_t value){
-    rvs.append("  .data\n");
-    rvs.append("  .globl " + string(value->name + 1) + "\n");
-    rvs.append(string(value->name + 1) + ":\n");
-    koopa_raw_value_t init = value->kind.data.global_alloc.init;
-    auto ty = value->ty->data.pointer.base;
-    if(ty->tag == KOOPA_RTT_INT32){
-        if(init->kind.tag == KOOPA_RVT_ZERO_INIT){
-            rvs.zeroInitInt();
-        } else {
-            int i = Visit(init->kind.data.integer);
-            rvs.word(i);
-        }
-    } else{
-        // see aggragate
-        assert (init->kind.tag == KOOPA_RVT_AGGREGATE) ;
-        initGlobalArray(init);
-    }
+void VisitGlobalVar(Value *value){
+    Value *init = value->ops[0];
+    // 全为0的放在.bss，只占大小；只读的常量数组放在.rodata
+    if(init->tag == Value::ZERO_INIT || init->isInt(0))
+        rvs.append("  .bss\n");
+    else if(value->value)
+        rvs.append("  .section .rodata\n");
+    else
+        rvs.append("  .data\n");
+    rvs.append("  .globl ");
+    rvs.append(symbol(value->name));
+    rvs.append('\n');
+    rvs.label(symbol(value->name));
+    size_t zeros = 0;
+    initGlobalArray(init, zeros);
+    flushZeros(zeros);
     rvs.append("\n");
     return ;
 }
 
-void initGlobalArray(koopa_raw_value_t init){
-    if(init->kind.tag == KOOPA_RVT_INTEGER){
-        int v = Visit(init->kind.data.integer);
-        rvs.word(v);
+// 输出初值，连续的0只累计字节数，遇到非零的值或结束时合并成一条 .zero
+void initGlobalArray(Value *init, size_t &zeros){
+    if(init->tag == Value::ZERO_INIT){
+        zeros += init->ty->getSize();
+    } else if(init->tag == Value::INTEGER){
+        if(init->value == 0){
+            zeros += 4;
+            return;
+        }
+        flushZeros(zeros);
+        rvs.word(init->value);
     } else {
-        // KOOPA_RVT_AGGREGATE
-        auto elems = init->kind.data.aggregate.elems;
-        for(int i = 0; i < elems.len; ++i){
-            initGlobalArray(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]));
+        // AGGREGATE
+        for(auto e : init->ops){
+            initGlobalArray(e, zeros);
         }
     }
 }
 
-// 访问getelemptr指令
-void Visit(const koopa_raw_get_elem_ptr_t& get_elem_ptr){
-    // getelemptr @arr, %2
-        // la t0, arr
-        // li t1 %2
-        // li t2 arr.size
-        // mul t1 t1 t2
-        // add t0 t0 t1
-    koopa_raw_value_t src = get_elem_ptr.src, index = get_elem_ptr.index;
-    size_t sz = getTypeSize(src->ty->data.pointer.base->data.array.base);
-        
-    // 将src的地址放到t0
-    if(src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        rvs.la("t0", string(src->name + 1));
-    }else if(src->kind.tag == KOOPA_RVT_FUNC_ARG_REF){
-        // 我们的KoopaIR保证遇不到
-    } else if(src->kind.tag == KOOPA_RVT_ALLOC){
-        // 栈上就是要找的地址
-        size_t offset = lva.getOffset(src);
-        if(rvs.immediate(offset)){
-            rvs.binary("addi", "t0", "sp", to_string(offset));
+void flushZeros(size_t &zeros){
+    if(zeros == 0) return;
+    rvs.append("  .zero ");
+    rvs.appendInt((int)zeros);
+    rvs.append('\n');
+    zeros = 0;
+}
+
+// 以2为底的对数，不是2的幂时返回-1
+int log2Exact(size_t x){
+    int k = 0;
+    while(((size_t)1 << k) < x)
+        ++k;
+    return ((size_t)1 << k) == x ? k : -1;
+}
+
+// 指针ptr指向的地址，表示为 base + offset。
+// 沿着并入的getelemptr/getptr链找到根，常量下标累加到offset，
+// 变量下标乘以步长(2的幂用slli)后累加到t1，最后加上根的地址写入dst。全局变量的地址放在t2中，可以被之后的访问复用。
+// self为真时ptr本身也是getelemptr/getptr，一并计算。只使用t0,t1,t2和dst，返回的base不会是t0(除非dst是t0)
+Address getAddress(Value *ptr, bool self, const string &dst){
+    vector<Value *> chain;
+    if(self){
+        chain.push_back(ptr);
+        ptr = ptr->ops[0];
+    }
+    while(asel.isFolded(ptr)){
+        chain.push_back(ptr);
+        ptr = ptr->ops[0];
+    }
+    int offset = 0;
+    bool has_index = false;     // t1中是否已有变量下标的部分
+    for(auto p : chain){
+        Value *index = p->ops[1];
+        size_t sz = p->tag == Value::GET_PTR ? p->ops[0]->ty->base->getSize()
+                                             : p->ops[0]->ty->base->base->getSize();
+        if(index->tag == Value::INTEGER){
+            offset += index->value * (int)sz;
+            continue;
+        }
+        string r = has_index ? "t2" : "t1";
+        string idx = loadValue(index, "t2");
+        if(r == "t2" || idx == "t2")
+            t2_global = nullptr;
+        int k = log2Exact(sz);
+        if(k >= 0){
+            rvs.binaryImm("slli", r, idx, k);
         } else {
-            rvs.li("t0", offset);
-            rvs.binary("add", "t0", "sp", "t0");
+            rvs.li("t0", sz);
+            rvs.binary("mul", r, idx, "t0");
         }
-    } else {
-        // 栈上存的是指针，间接索引
-        rvs.load("t0", "sp", lva.getOffset(src));
+        if(has_index)
+            rvs.binary("add", "t1", "t1", "t2");
+        has_index = true;
     }
-    // 将index放到t1
-    if(index->kind.tag == KOOPA_RVT_INTEGER){
-        int v = Visit(index->kind.data.integer);
-        rvs.li("t1", v);
-    } else {
-        // 其他情况就是栈上的临时变量
-        rvs.load("t1", "sp", lva.getOffset(index));
-    }
-    // 将size放到t2
-    rvs.li("t2", sz);
-    // 计算真实地址 index * size + base
-    rvs.binary("mul", "t1", "t1", "t2");
-    rvs.binary("add", "t0", "t0", "t1");
-}
-
-// 访问getptr指令
-void Visit(const koopa_raw_get_ptr_t& get_ptr){
-    koopa_raw_value_t src = get_ptr.src, index = get_ptr.index;
-    size_t sz = getTypeSize(src->ty->data.pointer.base);
-
-    // 将src的地址放到t0
-    if(src->kind.tag == KOOPA_RVT_GLOBAL_ALLOC){
-        rvs.la("t0", string(src->name + 1));
-    }else if(src->kind.tag == KOOPA_RVT_FUNC_ARG_REF){
-        // 我们的KoopaIR保证遇不到
-    } else if(src->kind.tag == KOOPA_RVT_ALLOC){
-        // 栈上就是要找的地址
-        size_t offset = lva.getOffset(src);
-        if(rvs.immediate(offset)){
-            rvs.binary("addi", "t0", "sp", to_string(offset));
-        } else {
-            rvs.li("t0", offset);
-            rvs.binary("add", "t0", "sp", "t0");
+
+    if(ptr->tag == Value::ALLOC){
+        // 栈上的偏移并入offset
+        offset += lva.getOffset(ptr);
+        if(!has_index)
+            return Address{"sp", offset};
+        rvs.binary("add", dst, "sp", "t1");
+        return Address{dst, offset};
+    }
+    if(ptr->tag == Value::GLOBAL_ALLOC){
+        if(t2_global != ptr){
+            // 单独算出的地址直接la到dst，访存用的地址留在t2中
+            if(!has_index && dst != "t1"){
+                rvs.la(dst, symbol(ptr->name));
+                return Address{dst, offset};
+            }
+            rvs.la("t2", symbol(ptr->name));
+            t2_global = ptr;
         }
-    } else {
-        // 栈上存的是指针，间接索引
-        rvs.load("t0", "sp", lva.getOffset(src));
+        if(!has_index)
+            return Address{"t2", offset};
+        rvs.binary("add", dst, "t2", "t1");
+        return Address{dst, offset};
     }
-    // 将index放到t1
-    if(index->kind.tag == KOOPA_RVT_INTEGER){
-        int v = Visit(index->kind.data.integer);
-        rvs.li("t1", v);
+    // 指针在寄存器或栈上，间接索引
+    if(!has_index)
+        return Address{loadValue(ptr, "t1"), offset};
+    string base = loadValue(ptr, "t2");
+    if(base == "t2")
+        t2_global = nullptr;
+    rvs.binary("add", dst, base, "t1");
+    return Address{dst, offset};
+}
+
+// 计算getelemptr/getptr的结果，写入rd
+void computeAddress(Value *value, const string &rd){
+    Address a = getAddress(value, true, rd);
+    if(a.offset == 0){
+        if(a.base != rd)
+            rvs.mov(a.base, rd);
+    } else if(rvs.immediate(a.offset)){
+        rvs.binaryImm("addi", rd, a.base, a.offset);
     } else {
-        // 其他情况就是栈上的临时变量
-        rvs.load("t1", "sp", lva.getOffset(index));
+        // base可能是t2中的全局变量地址，这时用t1放偏移
+        string t = a.base == "t2" ? "t1" : "t2";
+        if(t == "t2")
+            t2_global = nullptr;
+        rvs.li(t, a.offset);
+        rvs.binary("add", rd, a.base, t);
     }
-    // 将size放到t2
-    rvs.li("t2", sz);
-    // 计算真实地址 index * size + base
-    rvs.binary("mul", "t1", "t1", "t2");
-    rvs.binary("add", "t0", "t0", "t1");
+}
+
+// 访问getelemptr指令，结果写入rd
+void VisitGetElemPtr(Value *get_elem_ptr, const string &rd){
+    computeAddress(get_elem_ptr, rd);
+}
+
+// 访问getptr指令，结果写入rd
+void VisitGetPtr(Value *get_ptr, const string &rd){
+    computeAddress(get_ptr, rd);
 }
 
 // 函数 局部变量分配栈地址
-void allocLocal(const koopa_raw_function_t &func){
-    for(size_t i = 0; i < func->bbs.len; ++i){
-        auto bb = reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
-        for(int j = 0; j < bb->insts.len; ++j){
-            auto value = reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+// 有计算结果的指令由寄存器分配决定位置，这里只处理alloc
+void allocLocal(Function *func){
+    for(auto bb : func->bbs){
+        for(auto value : bb->insts){
 
             // 下面开始处理一条指令
 
             // 特判alloc
-            if(value->kind.tag == KOOPA_RVT_ALLOC ){
-                int sz = getTypeSize(value->ty->data.pointer.base);
+            if(value->tag == Value::ALLOC){
+                int sz = value->ty->base->getSize();
                 lva.alloc(value, sz);
                 continue;
             }
-            if(value->kind.tag == KOOPA_RVT_CALL){
-                koopa_raw_call_t c = value->kind.data.call;
+            if(value->tag == Value::CALL){
                 lva.setR();                 // 保存恢复ra
-                lva.setA((size_t)max(0, ((int)c.args.len - 8 ) * 4));    // 超过8个参数
-            }
-            size_t sz = getTypeSize(value->ty);
-            if(sz){
-                lva.alloc(value, sz);
+                lva.setA((size_t)max(0, ((int)value->ops.size() - 8 ) * 4));    // 超过8个参数
             }
         }
     }
-}   
-
-// 计算类型koopa_raw_type_t的大小
-size_t getTypeSize(koopa_raw_type_t ty){
-    switch(ty->tag){
-        case KOOPA_RTT_INT32:
-            return 4;
-        case KOOPA_RTT_UNIT:
-            return 0;
-        case KOOPA_RTT_ARRAY:
-            return ty->data.array.len * getTypeSize(ty->data.array.base);
-        case KOOPA_RTT_POINTER:
-            return 4;
-        case KOOPA_RTT_FUNCTION:
-            return 0;
-    }
-    return 0;
-}
\ No newline at end of file
+}